@@ -16,6 +16,8 @@ class ImageBoxTool:
         self.current_digit_index = 0
         self.digits = ["Units", "Tens", "Hundreds", "Thousands"]
         self.box_coordinates_list = []
+        self.corner_names = ["top-left", "top-right", "bottom-right", "bottom-left"]
+        self.corners = []
 
         self.canvas.bind("<Button-1>", self.start_selection)
         self.canvas.bind("<B1-Motion>", self.update_selection)
@@ -41,21 +43,41 @@ class ImageBoxTool:
         if self.current_digit_index < len(self.digits):
             digit = self.digits[self.current_digit_index]
             messagebox.showinfo("Digit Selection", f"Select the {digit} digit by drawing a box around it.")
+        else:
+            self.prompt_corner()
+
+    def prompt_corner(self):
+        if len(self.corners) < len(self.corner_names):
+            corner = self.corner_names[len(self.corners)]
+            messagebox.showinfo("Perspective Calibration", f"Click the {corner} corner of the digit window.")
         else:
             self.display_summary()
             messagebox.showinfo("Digit Selection", "All digits have been selected. Proceed.")
 
+    def selecting_corners(self):
+        return self.current_digit_index >= len(self.digits)
+
     def start_selection(self, event):
         x, y = event.x, event.y
+        if self.selecting_corners():
+            if len(self.corners) < len(self.corner_names):
+                self.corners.append((x, y))
+                self.canvas.create_oval(x - 3, y - 3, x + 3, y + 3, outline="blue")
+                self.prompt_corner()
+            return
         self.box_coordinates = [x, y, x, y]
         self.selection_boxes.append(self.canvas.create_rectangle(x, y, x, y, outline="red"))
 
     def update_selection(self, event):
+        if self.selecting_corners():
+            return
         x, y = event.x, event.y
         self.box_coordinates[2], self.box_coordinates[3] = x, y
         self.canvas.coords(self.selection_boxes[-1], self.box_coordinates[0], self.box_coordinates[1], x, y)
 
     def end_selection(self, event):
+        if self.selecting_corners():
+            return
         units = self.box_coordinates
         self.box_coordinates_list.append(units)
         messagebox.showinfo("Box Selection", f"Box coordinates for {self.digits[self.current_digit_index]}: {units}")
@@ -67,6 +89,44 @@ class ImageBoxTool:
         print("Summary of Box Coordinates:")
         for i, digit_coords in enumerate(self.box_coordinates_list):
             print(f"{self.digits[i]}: {digit_coords}")
+        if len(self.corners) == len(self.corner_names):
+            h = window_homography(self.corners)
+            values = ", ".join(f"{v:.6g}f" for v in h)
+            print("Paste into vendredi.ino:")
+            print(f"const homography_t calibrationHomography = {{ {{ {values} }} }};")
+
+
+def solve_linear(a, b):
+    # Elimination de Gauss avec pivot partiel (8x8, pas besoin de numpy)
+    n = len(b)
+    m = [row[:] + [b[i]] for i, row in enumerate(a)]
+    for col in range(n):
+        pivot = max(range(col, n), key=lambda r: abs(m[r][col]))
+        m[col], m[pivot] = m[pivot], m[col]
+        for r in range(col + 1, n):
+            f = m[r][col] / m[col][col]
+            for c in range(col, n + 1):
+                m[r][c] -= f * m[col][c]
+    x = [0.0] * n
+    for r in range(n - 1, -1, -1):
+        x[r] = (m[r][n] - sum(m[r][c] * x[c] for c in range(r + 1, n))) / m[r][r]
+    return x
+
+
+def window_homography(corners):
+    # Homographie qui envoie le rectangle redressé (même coin haut-gauche, largeur et hauteur
+    # moyennes des côtés cliqués) sur le quadrilatère vu par la caméra
+    (x0, y0), (x1, y1), (x2, y2), (x3, y3) = corners
+    width = (((x1 - x0) ** 2 + (y1 - y0) ** 2) ** 0.5 + ((x2 - x3) ** 2 + (y2 - y3) ** 2) ** 0.5) / 2
+    height = (((x3 - x0) ** 2 + (y3 - y0) ** 2) ** 0.5 + ((x2 - x1) ** 2 + (y2 - y1) ** 2) ** 0.5) / 2
+    src = [(x0, y0), (x0 + width, y0), (x0 + width, y0 + height), (x0, y0 + height)]
+    a, b = [], []
+    for (u, v), (x, y) in zip(src, corners):
+        a.append([u, v, 1, 0, 0, 0, -u * x, -v * x])
+        b.append(x)
+        a.append([0, 0, 0, u, v, 1, -u * y, -v * y])
+        b.append(y)
+    return solve_linear(a, b) + [1.0]
 
 if __name__ == "__main__":
     root = tk.Tk()
@@ -0,0 +1,68 @@
+// Vérifications sur PC de l'ordonnanceur de lectures (vendredi/capture_schedule.h) :
+//   g++ -std=c++17 -I../vendredi capture_schedule_test.cpp -o capture_schedule_test && ./capture_schedule_test
+
+#include <assert.h>
+#include <stdio.h>
+#include "capture_schedule.h"
+
+static capture_schedule_t make_schedule() {
+  capture_schedule_t s = {};
+  s.min_interval_ms = 5000;
+  s.max_interval_ms = 600000;
+  s.target_step = 2;
+  s.burst_count = 3;
+  schedule_init(&s, 100000);
+  return s;
+}
+
+// Débit constant : l'intervalle converge vers target_step unités par lecture
+static void test_steady_flow() {
+  capture_schedule_t s = make_schedule();
+  double t = 0, pos = 0;
+  const double flow = 0.05; // unités par seconde
+  uint32_t next = 0;
+  for (int i = 0; i < 40; i++) {
+    next = schedule_update(&s, (int)pos % 10, (int64_t)(t * 1e6));
+    pos += flow * next / 1000.0;
+    t += next / 1000.0;
+  }
+  assert(next >= 30000 && next <= 50000);
+}
+
+// Compteur à l'arrêt : l'intervalle s'allonge jusqu'au maximum
+static void test_idle() {
+  capture_schedule_t s = make_schedule();
+  uint32_t next = 0;
+  int64_t t = 0;
+  for (int i = 0; i < 30; i++) {
+    next = schedule_update(&s, 7, t);
+    t += (int64_t)next * 1000;
+  }
+  assert(next == s.max_interval_ms);
+}
+
+// Un pas après des heures de lectures ratées (last_us jamais avancé) : débit non nul, pas de
+// division par zéro
+static void test_step_after_long_gap() {
+  capture_schedule_t s = make_schedule();
+  schedule_update(&s, 3, 0);
+  for (int64_t hours = 1; hours <= 48; hours++) {
+    schedule_update(&s, -1, hours * 3600000000LL);
+  }
+  uint32_t next = schedule_update(&s, 4, 48 * 3600000000LL + 1);
+  assert(s.rate_uph > 0);
+  assert(next >= s.min_interval_ms && next <= s.max_interval_ms);
+  // Et de nouveau après un long arrêt avec un débit déjà retombé à zéro
+  s.rate_uph = 0;
+  next = schedule_update(&s, 5, 200 * 3600000000LL);
+  assert(s.rate_uph > 0);
+  assert(next >= s.min_interval_ms && next <= s.max_interval_ms);
+}
+
+int main() {
+  test_steady_flow();
+  test_idle();
+  test_step_after_long_gap();
+  printf("capture_schedule: OK\n");
+  return 0;
+}
@@ -0,0 +1,89 @@
+// Mesure sur PC de la localisation des chiffres (vendredi/digit_locator.h) sur une image VGA
+// synthétique, et vérification du contrôle de dérive :
+//   g++ -std=c++17 -O2 -I../vendredi digit_locator_bench.cpp -o digit_locator_bench && ./digit_locator_bench
+// Les durées sont celles du PC : sur l'ESP32, compter un ordre de grandeur de plus.
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include "digit_locator.h"
+
+#define W 640
+#define H 480
+
+static locator_work_t work;
+
+// Bande sombre (fenêtre du totalisateur) sur cadran clair, quatre chiffres clairs dedans.
+// `digits` : '8' (contour et barre du milieu) ou '1' (barre verticale), décalage (dx, dy).
+static void make_frame(std::vector<uint8_t>& img, const char* digits, int dx, int dy) {
+  srand(1);
+  for (int y = 0; y < H; y++)
+    for (int x = 0; x < W; x++) img[y * W + x] = 170 + (rand() % 11 - 5);
+  for (int y = 190 + dy; y < 270 + dy; y++)
+    for (int x = 120 + dx; x < 520 + dx; x++) img[y * W + x] = 30 + (rand() % 7);
+  for (int d = 0; d < NUM_DIGITS; d++) {
+    int gx = 150 + dx + d * 95, gy = 200 + dy;
+    for (int y = gy; y < gy + 60; y++) {
+      for (int x = gx; x < gx + 40; x++) {
+        bool ink;
+        if (digits[d] == '1') {
+          ink = x >= gx + 26 && x < gx + 33;
+        } else {
+          ink = x < gx + 7 || x >= gx + 33 || y < gy + 7 || y >= gy + 53 || (y >= gy + 27 && y < gy + 33);
+        }
+        if (ink) img[y * W + x] = 230;
+      }
+    }
+  }
+}
+
+static double microseconds(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+  return std::chrono::duration<double, std::micro>(b - a).count();
+}
+
+int main() {
+  std::vector<uint8_t> img(W * H);
+  make_frame(img, "8888", 0, 0);
+  digit_layout_t layout;
+  memset(&layout, 0, sizeof(layout));
+  bool found = locate_digits(img.data(), W, H, &work, &layout);
+  assert(found);
+  assert(layout.row_center != LOCATOR_NO_SIGNATURE);
+  printf("bande %d,%d %dx%d\n", layout.strip.x, layout.strip.y, layout.strip.w, layout.strip.h);
+
+  // Durées : localisation complète, puis contrôle de dérive seul
+  const int N = 500;
+  digit_layout_t scratch = layout;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < N; i++) {
+    scratch.valid = false;
+    locate_digits(img.data(), W, H, &work, &scratch);
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  uint32_t runs = layout.runs;
+  for (int i = 0; i < N; i++) update_digit_layout(img.data(), W, H, &work, &layout);
+  auto t2 = std::chrono::steady_clock::now();
+  assert(layout.runs == runs);
+  printf("localisation complète %.1f us, contrôle de dérive %.1f us\n",
+         microseconds(t0, t1) / N, microseconds(t1, t2) / N);
+
+  // Des chiffres qui changent, compteur immobile : pas de nouvelle localisation
+  const char* readings[] = { "1888", "1118", "8111", "1111", "8881" };
+  for (const char* r : readings) {
+    make_frame(img, r, 0, 0);
+    update_digit_layout(img.data(), W, H, &work, &layout);
+    assert(layout.runs == runs);
+  }
+  printf("chiffres changés : %u localisation(s) de plus\n", layout.runs - runs);
+
+  // Caméra déplacée de 12 px et 10 px : nouvelle localisation, boîtes suivies
+  make_frame(img, "8888", 12, 10);
+  int x_before = layout.digits[0].x;
+  update_digit_layout(img.data(), W, H, &work, &layout);
+  assert(layout.runs == runs + 1);
+  printf("bande déplacée : relocalisée, premier chiffre x %d -> %d\n", x_before, layout.digits[0].x);
+  printf("digit_locator: OK\n");
+  return 0;
+}
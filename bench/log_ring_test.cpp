@@ -0,0 +1,164 @@
+// Vérifications sur PC du journal différé (vendredi/log_ring.h) et de son décodage par logDecode.py :
+//   g++ -std=c++17 -O2 -pthread -I../vendredi log_ring_test.cpp -o log_ring_test && ./log_ring_test
+// À lancer depuis bench/ : le décodage appelle python3 ../logDecode.py.
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "log_formats.h"
+#include "log_ring.h"
+
+#define WRITERS  4
+#define MESSAGES 200000
+#define CAPACITY 64 // petit anneau : les écrivains le rattrapent sans cesse
+
+// Tous les champs d'un enregistrement dérivent de (écrivain, compteur) : un mélange de deux
+// écritures se voit forcément
+static int32_t mix(uint32_t writer, uint32_t n) {
+  return (int32_t)(n * 2654435761u ^ writer);
+}
+
+static void write_message(log_ring_t* ring, uint32_t writer, uint32_t n) {
+  int32_t a2 = mix(writer, n);
+  log_write(ring, (uint16_t)writer, n, (uint8_t)writer, writer, n, a2, writer ^ n ^ a2 ^ 0x5a5a5a5a);
+}
+
+static bool consistent(const log_record_t* r) {
+  uint32_t writer = r->id, n = r->us;
+  return writer < WRITERS && r->core == writer && r->unused == 0 && r->args[0] == (int32_t)writer &&
+         r->args[1] == (int32_t)n && r->args[2] == mix(writer, n) &&
+         r->args[3] == (int32_t)(writer ^ n ^ (uint32_t)r->args[2] ^ 0x5a5a5a5a);
+}
+
+// Plusieurs écrivains, un lecteur : jamais d'enregistrement déchiré, l'ordre de chaque écrivain est
+// respecté, et chaque message est soit lu soit compté comme perdu
+static void test_concurrent() {
+  static log_slot_t slots[CAPACITY];
+  log_ring_t ring;
+  bool ok = log_init(&ring, slots, CAPACITY);
+  assert(ok);
+
+  std::atomic<int> running(WRITERS);
+  std::vector<std::thread> writers;
+  for (uint32_t w = 0; w < WRITERS; w++) {
+    writers.emplace_back([&, w] {
+      for (uint32_t n = 0; n < MESSAGES; n++) {
+        write_message(&ring, w, n);
+        if (n % 32 == 0) std::this_thread::yield(); // laisse passer le lecteur sur un seul cœur
+      }
+      running--;
+    });
+  }
+
+  log_cursor_t cursor = log_oldest(&ring);
+  log_record_t record;
+  int64_t last[WRITERS];
+  for (int w = 0; w < WRITERS; w++) last[w] = -1;
+  uint32_t read = 0;
+  for (;;) {
+    bool done = running.load() == 0; // avant la lecture : après, tout est écrit
+    while (log_read(&ring, &cursor, &record)) {
+      assert(consistent(&record));
+      assert((int64_t)record.us > last[record.id]);
+      last[record.id] = record.us;
+      read++;
+    }
+    if (done) break;
+    std::this_thread::yield();
+  }
+  for (auto& th : writers) th.join();
+
+  uint32_t written = ring.head.load();
+  assert(written == WRITERS * MESSAGES);
+  assert(read + cursor.lost == written);
+  printf("log_ring: %u écrits, %u lus, %u perdus, 0 déchiré\n", written, read, cursor.lost);
+}
+
+// Le contenu de /log (même en-tête que log_handler) relu par logDecode.py : chaque ligne doit
+// être celle qu'aurait formatée printf avec la table de log_formats.h
+static void test_decode() {
+#define LOG_FORMAT_TEXT(id, format) format,
+  static const char* formats[] = { LOG_FORMATS(LOG_FORMAT_TEXT) };
+#undef LOG_FORMAT_TEXT
+  static log_slot_t slots[8];
+  log_ring_t ring;
+  log_init(&ring, slots, 8);
+  // Dix messages dans huit cases : les deux premiers sont écrasés
+  log_write(&ring, LOG_READING_FAILED, 1000, 0, 0, 0, 0, 0);
+  log_write(&ring, LOG_READING_FAILED, 2000, 0, 0, 0, 0, 0);
+  log_write(&ring, LOG_CROP_SIZE, 1234567, 1, 320, 240, 0, 0);
+  log_write(&ring, LOG_DIGIT, 2500000, 1, 3, -1, 0, 0);
+  log_write(&ring, LOG_CAPTURE_STATS, 3000001, 0, 2, 4711, 7, 0);
+  log_write(&ring, LOG_WIFI_READY, 4000000, 0, 192, 168, 1, 42);
+  log_write(&ring, LOG_WHEEL, 5999999, 1, 3285, 88, 5, 1);
+  log_write(&ring, LOG_METER, 61000000, 0, 1234, 1, 4, 0);
+  log_write(&ring, LOG_PUBLISH, 62000000, 1, -1, 17, 0, 0);
+  log_write(&ring, LOG_SLEEP, 4294967295u, 0, 3, 123456, 450, 0);
+
+  std::string data("LOG1", 4);
+  uint16_t record_size = sizeof(log_record_t);
+  uint16_t format_count = LOG_FORMAT_COUNT;
+  uint32_t written = ring.head.load();
+  data.append((const char*)&record_size, 2);
+  data.append((const char*)&format_count, 2);
+  data.append((const char*)&written, 4);
+
+  std::vector<std::string> expected;
+  log_cursor_t cursor = log_oldest(&ring);
+  log_record_t r;
+  while (log_read(&ring, &cursor, &r)) {
+    data.append((const char*)&r, sizeof(r));
+    char text[160], line[200];
+    snprintf(text, sizeof(text), formats[r.id], r.args[0], r.args[1], r.args[2], r.args[3]);
+    snprintf(line, sizeof(line), "[%u.%03u] cœur %u %s", r.us / 1000000, r.us / 1000 % 1000, r.core,
+             text);
+    expected.push_back(line);
+  }
+  assert(expected.size() == 8);
+
+  const char* path = "log_ring_test.bin";
+  FILE* f = fopen(path, "wb");
+  assert(f);
+  fwrite(data.data(), 1, data.size(), f);
+  fclose(f);
+
+  FILE* p = popen("python3 ../logDecode.py log_ring_test.bin 2>&1", "r");
+  if (!p) {
+    printf("log_ring: python3 introuvable, décodage non vérifié\n");
+    return;
+  }
+  std::vector<std::string> lines;
+  char buf[256];
+  while (fgets(buf, sizeof(buf), p)) {
+    buf[strcspn(buf, "\n")] = 0;
+    lines.push_back(buf);
+  }
+  int status = pclose(p);
+  remove(path);
+  if (status != 0) {
+    for (auto& l : lines) printf("%s\n", l.c_str());
+  }
+  assert(status == 0);
+  // Le résumé, puis une ligne par message
+  char summary[80];
+  snprintf(summary, sizeof(summary), "8 messages affichés, %u écrits depuis le démarrage", written);
+  assert(lines.size() == expected.size() + 1 && lines[0] == summary);
+  for (size_t i = 0; i < expected.size(); i++) {
+    if (lines[i + 1] != expected[i]) {
+      printf("attendu : %s\nobtenu  : %s\n", expected[i].c_str(), lines[i + 1].c_str());
+    }
+    assert(lines[i + 1] == expected[i]);
+  }
+  printf("log_ring: %zu messages décodés à l'identique par logDecode.py\n", expected.size());
+}
+
+int main() {
+  test_concurrent();
+  test_decode();
+  printf("log_ring: OK\n");
+  return 0;
+}
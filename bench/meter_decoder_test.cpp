@@ -0,0 +1,106 @@
+// Vérifications sur PC de l'assemblage des chiffres en index (vendredi/meter_decoder.h) :
+//   g++ -std=c++17 -I../vendredi meter_decoder_test.cpp -o meter_decoder_test && ./meter_decoder_test
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "meter_decoder.h"
+
+// Mêmes règles que vendredi.ino (scores Q9.7 : 2 << 7 = 2,0)
+static const meter_rules_t rules = { 2 << 7, 2 << 7, 500, 20, 3 };
+
+typedef struct {
+  uint32_t value;
+  meter_verdict_t verdict;
+  int first;       // chiffre le plus à gauche passé au modèle
+} meter_result_t;
+
+// Une lecture comme dans infer_reading() : les unités, puis les chiffres demandés par
+// meter_digits_needed. Le modèle « voit » `shown` (chiffre vrai à 10,0, les autres à 0).
+static meter_result_t read_meter(meter_state_t* state, uint32_t shown) {
+  meter_scores_t scores;
+  memset(scores, 0, sizeof(scores));
+  int first = NUM_DIGITS - 1;
+  scores[first][meter_digit(shown, first)] = 10 << 7;
+  for (;;) {
+    int needed = meter_digits_needed(&rules, state, scores, first);
+    if (needed >= first) break;
+    for (int d = needed; d < first; d++) scores[d][meter_digit(shown, d)] = 10 << 7;
+    first = needed;
+  }
+  meter_result_t r;
+  r.first = first;
+  r.verdict = meter_decode(&rules, state, scores, first, &r.value);
+  return r;
+}
+
+static meter_state_t state_at(uint32_t value) {
+  meter_state_t state;
+  memset(&state, 0, sizeof(state));
+  meter_result_t r = read_meter(&state, value);
+  assert(r.verdict == METER_REBASED && r.first == 0 && r.value == value);
+  return state;
+}
+
+static void test_units_only() {
+  meter_state_t state = state_at(1234);
+  meter_result_t r = read_meter(&state, 1236);
+  assert(r.verdict == METER_ACCEPTED && r.value == 1236);
+  assert(r.first == NUM_DIGITS - 1); // une seule inférence
+}
+
+static void test_units_wrap_reads_tens() {
+  meter_state_t state = state_at(1238);
+  meter_result_t r = read_meter(&state, 1241);
+  assert(r.verdict == METER_ACCEPTED && r.value == 1241);
+  assert(r.first == NUM_DIGITS - 2); // unités puis dizaines
+}
+
+static void test_double_wrap() {
+  meter_state_t state = state_at(1299);
+  meter_result_t r = read_meter(&state, 1300);
+  assert(r.verdict == METER_ACCEPTED && r.value == 1300);
+  assert(r.first == NUM_DIGITS - 3); // unités, dizaines, centaines ; pas les milliers
+}
+
+// Les unités reculent sans que les dizaines aient bougé : aucun index plausible
+static void test_impossible_rejected() {
+  meter_state_t state = state_at(1234);
+  meter_result_t r = read_meter(&state, 1232);
+  assert(r.verdict == METER_REJECTED && r.value == 1234);
+  assert(state.value == 1234 && state.rejected == 1);
+}
+
+// Compteur remplacé : rejets jusqu'à rebase_after lectures complètes identiques
+static void test_rebase() {
+  meter_state_t state = state_at(1234);
+  for (int i = 1; i < rules.rebase_after; i++) {
+    meter_result_t r = read_meter(&state, 5000);
+    assert(r.verdict == METER_REJECTED && r.value == 1234 && r.first == 0);
+  }
+  meter_result_t r = read_meter(&state, 5000);
+  assert(r.verdict == METER_REBASED && r.value == 5000 && r.first == 0);
+  r = read_meter(&state, 5001);
+  assert(r.verdict == METER_ACCEPTED && r.value == 5001 && r.first == NUM_DIGITS - 1);
+}
+
+// Le totalisateur reboucle après 9999
+static void test_wrap_past_9999() {
+  meter_state_t state = state_at(9998);
+  meter_result_t r = read_meter(&state, 1);
+  assert(r.verdict == METER_ACCEPTED && r.value == 1);
+  assert(r.first == 0);
+  r = read_meter(&state, 3);
+  assert(r.verdict == METER_ACCEPTED && r.value == 3 && r.first == NUM_DIGITS - 1);
+}
+
+int main() {
+  test_units_only();
+  test_units_wrap_reads_tens();
+  test_double_wrap();
+  test_impossible_rejected();
+  test_rebase();
+  test_wrap_past_9999();
+  printf("meter_decoder: OK\n");
+  return 0;
+}
@@ -0,0 +1,67 @@
+// Vérifications sur PC du réservoir de demandes /capture (vendredi/slot_pool.h) :
+//   g++ -std=c++17 -O2 -pthread -I../vendredi slot_pool_test.cpp -o slot_pool_test && ./slot_pool_test
+
+#include <assert.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+#include "slot_pool.h"
+
+#define POOL 16
+
+// Toutes les cases une fois, puis -1, puis la case rendue est reprise
+static void test_exhaustion() {
+  slot_pool_t pool;
+  slot_pool_init(&pool, POOL);
+  bool seen[POOL] = {};
+  for (int n = 0; n < POOL; n++) {
+    int i = slot_pool_take(&pool);
+    assert(i >= 0 && i < POOL && !seen[i]);
+    seen[i] = true;
+  }
+  assert(slot_pool_take(&pool) == -1);
+  slot_pool_give(&pool, 5);
+  assert(slot_pool_take(&pool) == 5);
+  assert(slot_pool_take(&pool) == -1);
+
+  slot_pool_t full;
+  slot_pool_init(&full, 32);
+  for (int n = 0; n < 32; n++) assert(slot_pool_take(&full) == n);
+  assert(slot_pool_take(&full) == -1);
+}
+
+// Plusieurs tâches prennent et rendent en même temps : jamais deux propriétaires pour une case
+static void test_concurrent() {
+  slot_pool_t pool;
+  slot_pool_init(&pool, POOL);
+  std::atomic<int> owner[POOL];
+  for (int i = 0; i < POOL; i++) owner[i].store(0);
+  std::atomic<int> conflicts(0), taken(0), refused(0);
+  std::vector<std::thread> threads;
+  for (int t = 1; t <= 6; t++) {
+    threads.emplace_back([&, t] {
+      for (int n = 0; n < 200000; n++) {
+        int i = slot_pool_take(&pool);
+        if (i < 0) {
+          refused++;
+          continue;
+        }
+        if (owner[i].exchange(t) != 0) conflicts++;
+        taken++;
+        owner[i].store(0);
+        slot_pool_give(&pool, i);
+      }
+    });
+  }
+  for (auto& th : threads) th.join();
+  assert(conflicts.load() == 0);
+  assert(pool.used.load() == 0);
+  printf("slot_pool: %d prises, %d refus, 0 conflit\n", taken.load(), refused.load());
+}
+
+int main() {
+  test_exhaustion();
+  test_concurrent();
+  printf("slot_pool: OK\n");
+  return 0;
+}
@@ -0,0 +1,63 @@
+// Débit sur PC de la file à un producteur et un consommateur (vendredi/spsc_ring.h), avec
+// vérification de l'ordre et qu'aucun élément n'est perdu ni dupliqué :
+//   g++ -std=c++17 -O2 -pthread -I../vendredi spsc_ring_bench.cpp -o spsc_ring_bench && ./spsc_ring_bench
+
+#include <assert.h>
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+#include "spsc_ring.h"
+
+#define ITEMS    20000000u
+#define CAPACITY 64
+
+// Éléments de la taille d'un uint32 (débit brut) et d'une image passée entre les étages
+typedef struct {
+  uint32_t sequence;
+  uint8_t payload[60];
+} frame_item_t;
+
+template <typename T>
+static void run(const char* name, uint32_t items) {
+  static T storage[CAPACITY];
+  spsc_ring_t ring;
+  bool ok = spsc_init(&ring, storage, CAPACITY, sizeof(T));
+  assert(ok);
+
+  auto start = std::chrono::steady_clock::now();
+  std::thread producer([&] {
+    T item = {};
+    for (uint32_t i = 0; i < items;) {
+      *(uint32_t*)&item = i;
+      if (spsc_push(&ring, &item)) i++;
+      else std::this_thread::yield(); // file pleine : laisse la main au consommateur
+    }
+  });
+  uint32_t expected = 0;
+  std::thread consumer([&] {
+    T item;
+    while (expected < items) {
+      if (spsc_pop(&ring, &item)) {
+        assert(*(uint32_t*)&item == expected); // dans l'ordre, sans perte ni doublon
+        expected++;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+  producer.join();
+  consumer.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  assert(expected == items);
+  assert(spsc_size(&ring) == 0);
+  printf("%-12s %u éléments de %2zu octets en %.3f s : %.1f M éléments/s\n", name, items, sizeof(T),
+         seconds, items / seconds / 1e6);
+}
+
+int main() {
+  run<uint32_t>("uint32", ITEMS);
+  run<frame_item_t>("64 octets", ITEMS / 4);
+  printf("spsc_ring: OK\n");
+  return 0;
+}
@@ -0,0 +1,90 @@
+// Vérifications sur PC de la position fractionnaire de la roue des unités (vendredi/wheel_position.h) :
+//   g++ -std=c++17 -I../vendredi wheel_position_test.cpp -o wheel_position_test && ./wheel_position_test
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "wheel_position.h"
+
+#define SIZE 28
+
+// Vignette 28x28 binarisée (bits de poids fort d'abord) : un chiffre occupe les lignes 4..23, la
+// roue l'a fait remonter de `shift` lignes (le chiffre suivant apparaît en bas)
+static void make_input(int shift, uint8_t* packed) {
+  memset(packed, 0, (SIZE * SIZE + 7) / 8);
+  for (int y = 0; y < SIZE; y++) {
+    int src = (y + shift) % SIZE;
+    if (src < 4 || src >= 24) continue;
+    for (int x = 8; x < 20; x++) {
+      int i = y * SIZE + x;
+      packed[i >> 3] |= 0x80 >> (i & 7);
+    }
+  }
+}
+
+// Scores d'une roue entre 3 et 4 : chacun proportionnel à la part visible du chiffre
+static void rolling_scores(int shift, int16_t* scores) {
+  memset(scores, 0, 10 * sizeof(int16_t));
+  scores[3] = (int16_t)(1000 * (SIZE - shift) / SIZE);
+  scores[4] = (int16_t)(1000 * shift / SIZE);
+}
+
+// Position croissante sur tout le passage de 3 à 4, et jamais hors de [3000, 4000]
+static void test_monotonic_sweep() {
+  uint8_t packed[(SIZE * SIZE + 7) / 8];
+  int16_t scores[10];
+  int previous = -1;
+  for (int shift = 0; shift < SIZE; shift++) {
+    make_input(shift, packed);
+    rolling_scores(shift, scores);
+    wheel_position_t w;
+    estimate_wheel_position(scores, packed, SIZE, SIZE, &w);
+    printf("décalage %2d : position %d, confiance %d\n", shift, w.position, w.confidence);
+    assert(w.position >= 3000 && w.position <= 4000);
+    assert(w.position >= previous);
+    assert(w.confidence > 0);
+    previous = w.position;
+  }
+}
+
+// Paire 3/4 presque égale, meilleur score sur le chiffre du bas : le profil reste rattaché à 3
+static void test_pair_with_lower_best() {
+  uint8_t packed[(SIZE * SIZE + 7) / 8];
+  int16_t scores[10] = {};
+  scores[3] = 520;
+  scores[4] = 480;
+  int previous = -1;
+  for (int shift = 12; shift <= 20; shift += 4) {
+    make_input(shift, packed);
+    wheel_position_t w;
+    estimate_wheel_position(scores, packed, SIZE, SIZE, &w);
+    assert(w.position > 3300 && w.position < 3800);
+    assert(w.confidence > 50);
+    assert(w.position > previous);
+    previous = w.position;
+    int offset;
+    assert(wheel_offset(&w, 3, &offset) && offset == w.position - 3000);
+  }
+}
+
+// Scores et profil incompatibles : pas de moyenne, et aucune part publiée
+static void test_disagreement() {
+  uint8_t packed[(SIZE * SIZE + 7) / 8];
+  int16_t scores[10] = {};
+  scores[3] = 900;
+  scores[4] = 300; // environ 3,25 d'après les scores
+  make_input(21, packed); // 3,75 d'après le profil
+  wheel_position_t w;
+  estimate_wheel_position(scores, packed, SIZE, SIZE, &w);
+  assert(w.confidence == 0);
+  int offset;
+  assert(!wheel_offset(&w, 3, &offset));
+}
+
+int main() {
+  test_monotonic_sweep();
+  test_pair_with_lower_best();
+  test_disagreement();
+  printf("wheel_position: OK\n");
+  return 0;
+}
@@ -0,0 +1,127 @@
+import argparse
+import os
+import urllib.request
+
+from PIL import Image
+
+# Décodeur des formats sans perte de /capture (voir vendredi/gray_codec.h) :
+#   python captureDecode.py capture.qog -o capture.png
+#   python captureDecode.py http://[YourIP]:81/capture?format=qog -o capture.png
+#   python captureDecode.py "http://[YourIP]:81/capture?digits=only" -o lecture
+
+
+def read_header(data):
+    magic = data[:4].decode('ascii')
+    largeur = data[4] | (data[5] << 8)
+    hauteur = data[6] | (data[7] << 8)
+    return magic, largeur, hauteur
+
+
+def decode_qog(data, largeur, hauteur):
+    pixels = bytearray(largeur * hauteur)
+    index = [0] * 63
+    prev = 0
+    pos = 8
+    i = 0
+    while i < len(pixels):
+        op = data[pos]
+        pos += 1
+        tag = op & 0xc0
+        if tag == 0x80:  # répétition
+            run = (op & 0x3f) + 1
+            pixels[i:i + run] = bytes([prev]) * run
+            i += run
+            continue
+        if tag == 0x00:  # deux petites différences
+            for diff in ((op >> 3) & 7, op & 7):
+                prev = (prev + diff - 4) & 0xff
+                index[(prev * 7) % 63] = prev
+                pixels[i] = prev
+                i += 1
+            continue
+        if op == 0xff:  # niveau en clair
+            v = data[pos]
+            pos += 1
+        elif tag == 0xc0:  # table des niveaux récents
+            v = index[op & 0x3f]
+        else:  # différence
+            v = (prev + (op & 0x3f) - 32) & 0xff
+        index[(v * 7) % 63] = v
+        pixels[i] = v
+        prev = v
+        i += 1
+    return bytes(pixels)
+
+
+def decode_bits(data, largeur, hauteur):
+    seuil = data[8]
+    octets_par_ligne = (largeur + 7) // 8
+    pixels = bytearray(largeur * hauteur)
+    for y in range(hauteur):
+        ligne = data[9 + y * octets_par_ligne:9 + (y + 1) * octets_par_ligne]
+        for x in range(largeur):
+            if ligne[x >> 3] & (0x80 >> (x & 7)):
+                pixels[y * largeur + x] = 255
+    print(f'Image binarisée au seuil {seuil}')
+    return bytes(pixels)
+
+
+def decode_digits(data, sortie):
+    # Entrées du modèle envoyées par /capture?digits=only : une image 28x28 par chiffre
+    nombre, hauteur, largeur, drapeaux = data[4], data[5], data[6], data[7]
+    timestamp_us = int.from_bytes(data[8:16], 'little', signed=True)
+    sequence = int.from_bytes(data[16:20], 'little')
+    pos = 20
+    resultats = []
+    for _ in range(nombre):
+        classe = int.from_bytes(data[pos:pos + 1], 'little', signed=True)
+        score = int.from_bytes(data[pos + 1:pos + 3], 'little', signed=True) / 128
+        resultats.append((classe, score))
+        pos += 3
+    taille = (hauteur * largeur + 7) // 8
+    print(f'Lecture {sequence} à {timestamp_us} us, valide : {bool(drapeaux & 1)}')
+    for d, (classe, score) in enumerate(resultats):
+        bits = data[pos + d * taille:pos + (d + 1) * taille]
+        pixels = bytes(255 if bits[i >> 3] & (0x80 >> (i & 7)) else 0 for i in range(hauteur * largeur))
+        if classe < 0:
+            # Chiffre que le modèle n'a pas relu (index inchangé) ou image rejetée
+            nom = f'{sortie}_{d}_nonlu.png'
+            print(f'Chiffre {d} : non lu par le modèle -> {nom}')
+        else:
+            nom = f'{sortie}_{d}_classe{classe}.png'
+            print(f'Chiffre {d} : classe {classe}, score {score:.2f} -> {nom}')
+        Image.frombytes('L', (largeur, hauteur), pixels).save(nom)
+
+
+def decode(data):
+    magic, largeur, hauteur = read_header(data)
+    if magic == 'QOG1':
+        pixels = decode_qog(data, largeur, hauteur)
+    elif magic == 'BIT1':
+        pixels = decode_bits(data, largeur, hauteur)
+    else:
+        raise ValueError(f'Format inconnu : {magic!r}')
+    return Image.frombytes('L', (largeur, hauteur), pixels)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Décode une image QOG ou BIT envoyée par /capture')
+    parser.add_argument('source', help='fichier ou URL de /capture?format=qog|bits')
+    parser.add_argument('-o', '--output', help='image de sortie (PNG par défaut)')
+    args = parser.parse_args()
+
+    if args.source.startswith('http://') or args.source.startswith('https://'):
+        with urllib.request.urlopen(args.source) as reponse:
+            data = reponse.read()
+    else:
+        with open(args.source, 'rb') as f:
+            data = f.read()
+
+    if data[:4] == b'DIG1':
+        decode_digits(data, os.path.splitext(args.output or 'digits')[0])
+        raise SystemExit
+
+    image = decode(data)
+    sortie = args.output or os.path.splitext(os.path.basename(args.source.split('?')[0]))[0] + '.png'
+    image.save(sortie)
+    print(f'Image décodée sauvegardée : {sortie} ({image.width}x{image.height}, {len(data)} octets reçus)')
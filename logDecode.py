@@ -0,0 +1,65 @@
+import argparse
+import os
+import re
+import struct
+import urllib.request
+
+# Décodeur du journal différé renvoyé par /log (voir vendredi/log_ring.h) :
+#   python logDecode.py http://[YourIP]:81/log
+#   python logDecode.py log.bin --formats vendredi/log_formats.h
+
+FORMATS_PAR_DEFAUT = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'vendredi', 'log_formats.h')
+SPECIFICATION = re.compile(r'%[-+ 0#]*\d*(?:\.\d+)?([diuxX%])')
+
+
+def read_formats(chemin):
+    # Lignes X(LOG_NOM, "format") de la macro LOG_FORMATS, dans l'ordre des identifiants
+    with open(chemin, encoding='utf-8') as f:
+        texte = f.read()
+    return [(nom, bytes(format, 'utf-8').decode('unicode_escape'))
+            for nom, format in re.findall(r'X\((\w+),\s*"((?:[^"\\]|\\.)*)"\)', texte)]
+
+
+def format_message(format, args):
+    valeurs = []
+    for conversion in SPECIFICATION.findall(format):
+        if conversion == '%':
+            continue
+        v = args[len(valeurs)]
+        valeurs.append(v & 0xffffffff if conversion in 'uxX' else v)
+    return format % tuple(valeurs)
+
+
+def decode_log(data, formats):
+    if data[:4] != b'LOG1':
+        raise ValueError(f'Format inconnu : {data[:4]!r}')
+    taille, nombre_formats, ecrits = struct.unpack_from('<HHI', data, 4)
+    if nombre_formats != len(formats):
+        print(f'Attention : {nombre_formats} formats sur la carte, {len(formats)} dans la table')
+    lignes = []
+    for pos in range(12, len(data) - taille + 1, taille):
+        us, identifiant, coeur, _, *args = struct.unpack_from('<IHBB4i', data, pos)
+        if identifiant < len(formats):
+            texte = format_message(formats[identifiant][1], args)
+        else:
+            texte = f'message inconnu {identifiant} {args}'
+        lignes.append(f'[{us // 1000000}.{us // 1000 % 1000:03d}] cœur {coeur} {texte}')
+    print(f'{len(lignes)} messages affichés, {ecrits} écrits depuis le démarrage')
+    return lignes
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Décode le journal binaire envoyé par /log')
+    parser.add_argument('source', help='fichier ou URL de /log')
+    parser.add_argument('--formats', default=FORMATS_PAR_DEFAUT, help='table des formats (log_formats.h)')
+    args = parser.parse_args()
+
+    if args.source.startswith('http://') or args.source.startswith('https://'):
+        with urllib.request.urlopen(args.source) as reponse:
+            data = reponse.read()
+    else:
+        with open(args.source, 'rb') as f:
+            data = f.read()
+
+    for ligne in decode_log(data, read_formats(args.formats)):
+        print(ligne)
@@ -0,0 +1,47 @@
+// Arène d'allocation linéaire : un seul bloc réservé au démarrage, découpé une fois pour toutes
+// entre les tampons du pipeline, jamais libéré. Après setup(), plus aucun malloc sur le chemin
+// de capture, donc plus de fragmentation du tas qui s'accumule au fil des semaines.
+// Le bloc lui-même est fourni par l'appelant (DRAM interne ou PSRAM).
+// Aucune dépendance Arduino : ce fichier compile aussi sur PC.
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ARENA_DEFAULT_ALIGN 8
+
+typedef struct {
+  const char* name;
+  uint8_t* base;
+  size_t size;
+  size_t used;
+  size_t failed; // octets demandés qui n'ont pas trouvé de place
+} arena_t;
+
+static void arena_init(arena_t* a, const char* name, void* base, size_t size) {
+  a->name = name;
+  a->base = (uint8_t*)base;
+  a->size = base ? size : 0;
+  a->used = 0;
+  a->failed = 0;
+}
+
+// `align` est une puissance de 2 ; renvoie NULL si l'arène est pleine
+static void* arena_alloc(arena_t* a, size_t size, size_t align) {
+  uintptr_t start = ((uintptr_t)a->base + a->used + align - 1) & ~(uintptr_t)(align - 1);
+  size_t offset = start - (uintptr_t)a->base;
+  if (!a->base || offset + size > a->size) {
+    a->failed += size;
+    return NULL;
+  }
+  a->used = offset + size;
+  return a->base + offset;
+}
+
+static size_t arena_remaining(const arena_t* a) {
+  return a->size - a->used;
+}
+
+#endif // __ARENA_H__
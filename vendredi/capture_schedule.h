@@ -0,0 +1,96 @@
+// Intervalle adaptatif entre deux lectures planifiées, réglé sur le débit d'eau observé :
+//  - le débit est estimé à partir de la roue des unités (chiffre de poids faible), seule assez
+//    fine pour voir un petit débit et insensible aux erreurs de lecture des chiffres de tête ;
+//  - pendant un écoulement, l'intervalle vise un déplacement de `target_step` unités par lecture,
+//    pour que la roue ne fasse jamais un tour complet entre deux lectures ;
+//  - au premier mouvement après un arrêt, une rafale de `burst_count` lectures rapprochées
+//    mesure vite le nouveau débit ;
+//  - sans mouvement alors qu'au moins une unité était attendue, le débit estimé diminue et
+//    l'intervalle s'allonge d'un facteur 3/2 jusqu'à max_interval_ms ;
+//  - après une longue série de lectures ratées, l'écart de temps est plafonné à deux
+//    max_interval_ms : un pas de roue n'y donne jamais un débit nul.
+// Aucune dépendance Arduino : ce fichier compile aussi sur PC.
+
+#ifndef __CAPTURE_SCHEDULE_H__
+#define __CAPTURE_SCHEDULE_H__
+
+#include <stdint.h>
+
+typedef struct {
+  uint32_t min_interval_ms;   // aussi l'intervalle des rafales
+  uint32_t max_interval_ms;
+  uint32_t target_step;       // unités de la roue de poids faible visées entre deux lectures
+  uint8_t burst_count;
+  // État
+  uint32_t interval_ms;       // prochain intervalle
+  uint32_t rate_uph;          // débit estimé, en unités par heure (moyenne glissante)
+  int8_t last_units;          // -1 : pas encore de lecture valide
+  int64_t last_us;
+  uint8_t burst_left;
+} capture_schedule_t;
+
+static uint32_t schedule_clamp(const capture_schedule_t* s, uint64_t ms) {
+  if (ms < s->min_interval_ms) return s->min_interval_ms;
+  if (ms > s->max_interval_ms) return s->max_interval_ms;
+  return (uint32_t)ms;
+}
+
+static void schedule_init(capture_schedule_t* s, uint32_t initial_ms) {
+  s->interval_ms = schedule_clamp(s, initial_ms);
+  s->rate_uph = 0;
+  s->last_units = -1;
+  s->last_us = 0;
+  s->burst_left = 0;
+}
+
+// Prend en compte une lecture (`units` : chiffre des unités, -1 si la lecture a échoué) faite à
+// l'instant `now_us`, et renvoie l'intervalle jusqu'à la prochaine lecture planifiée.
+static uint32_t schedule_update(capture_schedule_t* s, int units, int64_t now_us) {
+  if (units < 0 || units > 9) {
+    return s->interval_ms; // lecture ratée : rien appris sur le débit
+  }
+  if (s->last_units < 0 || now_us <= s->last_us) {
+    s->last_units = (int8_t)units;
+    s->last_us = now_us;
+    return s->interval_ms;
+  }
+
+  // Moins d'un tour de roue entre deux lectures, c'est le but de l'ordonnanceur
+  uint32_t step = (uint32_t)((units - s->last_units + 10) % 10);
+  uint64_t elapsed_us = (uint64_t)(now_us - s->last_us);
+  uint64_t max_elapsed_us = (uint64_t)s->max_interval_ms * 2000;
+  if (elapsed_us > max_elapsed_us) elapsed_us = max_elapsed_us;
+  if (step == 0 && s->rate_uph > 0 && (uint64_t)s->rate_uph * elapsed_us < 3600000000ULL) {
+    // Moins d'une unité attendue depuis le dernier mouvement : rien à conclure, la mesure
+    // repartira de ce mouvement (rafale sur un débit lent par exemple)
+    if (s->burst_left > 0) {
+      s->burst_left--;
+      return s->min_interval_ms;
+    }
+    return s->interval_ms;
+  }
+  s->burst_left = step ? s->burst_left : 0;
+  uint32_t sample_uph = (uint32_t)((uint64_t)step * 3600000000ULL / elapsed_us);
+  bool was_idle = s->rate_uph == 0;
+  s->rate_uph = (s->rate_uph + sample_uph) / 2;
+  s->last_units = (int8_t)units;
+  s->last_us = now_us;
+
+  if (step == 0) {
+    s->interval_ms = schedule_clamp(s, (uint64_t)s->interval_ms * 3 / 2);
+    return s->interval_ms;
+  }
+
+  if (was_idle) {
+    s->burst_left = s->burst_count;
+  }
+  if (s->rate_uph == 0) s->rate_uph = 1; // la roue a bougé : jamais de débit nul ici
+  s->interval_ms = schedule_clamp(s, (uint64_t)s->target_step * 3600000 / s->rate_uph);
+  if (s->burst_left > 0) {
+    s->burst_left--;
+    return s->min_interval_ms;
+  }
+  return s->interval_ms;
+}
+
+#endif // __CAPTURE_SCHEDULE_H__
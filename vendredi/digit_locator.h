@@ -0,0 +1,423 @@
+// Localisation automatique de la bande des chiffres et de chaque chiffre, à la place des
+// constantes ROI_* et des boîtes relevées à la main avec DigitBoxCallibrage.py.
+// Travaille sur une image réduite (facteur LOCATOR_SCALE) :
+//  1. profil des lignes (énergie du gradient horizontal) -> bande des chiffres
+//  2. profil des colonnes dans la bande -> étendue horizontale de la fenêtre des chiffres
+//  3. seuil d'Otsu + composantes connexes dans cette zone -> un rectangle par chiffre,
+//     le profil des colonnes servant aussi à couper deux chiffres collés
+// Le résultat est mis en cache ; une signature (centres de masse du gradient dans un cadre autour
+// de la bande, hors des chiffres) permet de vérifier à chaque image que la bande n'a pas bougé, et de
+// ne relancer la recherche qu'en cas de dérive. Le cadre ne voit que le bord de la fenêtre et le
+// cadran : un chiffre qui change (1 -> 8) ne déplace pas la signature.
+// Aucune dépendance Arduino : ce fichier compile aussi sur PC.
+
+#ifndef __DIGIT_LOCATOR_H__
+#define __DIGIT_LOCATOR_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#define NUM_DIGITS             4   // de gauche (poids fort) à droite (unités)
+#define LOCATOR_SCALE          4
+#define LOCATOR_MAX_W          (640 / LOCATOR_SCALE)
+#define LOCATOR_MAX_H          (480 / LOCATOR_SCALE)
+#define LOCATOR_MAX_STRIP_H    48  // hauteur max de la bande, en pixels réduits
+#define LOCATOR_MAX_COMPONENTS 64
+#define LOCATOR_DRIFT_LIMIT    24  // dérive tolérée, en 1/16 de pixel réduit (1,5 px)
+#define LOCATOR_MIN_TEXTURE    4   // gradient moyen minimal du cadre pour que la signature serve
+#define LOCATOR_NO_SIGNATURE   INT32_MIN
+
+typedef struct {
+  int16_t x, y, w, h;
+} digit_box_t;
+
+typedef struct {
+  bool valid;
+  digit_box_t strip;              // bande des chiffres, en pixels pleine résolution
+  digit_box_t digits[NUM_DIGITS]; // rectangles des chiffres, en pixels pleine résolution
+  int32_t row_center;             // signature de la bande (1/16 de pixel réduit),
+  int32_t col_center;             // LOCATOR_NO_SIGNATURE si le cadre est trop uniforme
+  uint32_t runs;                  // nombre de localisations complètes
+  uint32_t drift_checks;
+} digit_layout_t;
+
+// Mémoire de travail, allouée une fois par l'appelant
+typedef struct {
+  uint8_t small[LOCATOR_MAX_W * LOCATOR_MAX_H];
+  uint16_t labels[LOCATOR_MAX_W * LOCATOR_MAX_STRIP_H];
+  uint16_t parent[LOCATOR_MAX_COMPONENTS * 4];
+  uint32_t profile[LOCATOR_MAX_W > LOCATOR_MAX_H ? LOCATOR_MAX_W : LOCATOR_MAX_H];
+} locator_work_t;
+
+typedef struct {
+  int16_t x0, y0, x1, y1;
+  uint16_t area;
+} locator_component_t;
+
+// Réduction par moyenne de 2x2 pixels au centre de chaque bloc LOCATOR_SCALE x LOCATOR_SCALE
+static void locator_downscale(const uint8_t* frame, int width, uint8_t* small, int sw, int sh) {
+  const int o = LOCATOR_SCALE / 2 - 1;
+  for (int y = 0; y < sh; y++) {
+    const uint8_t* r0 = frame + (y * LOCATOR_SCALE + o) * width + o;
+    const uint8_t* r1 = r0 + width;
+    uint8_t* out = small + y * sw;
+    for (int x = 0; x < sw; x++) {
+      int i = x * LOCATOR_SCALE;
+      out[x] = (r0[i] + r0[i + 1] + r1[i] + r1[i + 1] + 2) >> 2;
+    }
+  }
+}
+
+// Seuil d'Otsu sur une zone de l'image réduite
+static int locator_otsu(const uint8_t* small, int sw, int x0, int y0, int x1, int y1) {
+  uint32_t hist[256];
+  memset(hist, 0, sizeof(hist));
+  for (int y = y0; y < y1; y++)
+    for (int x = x0; x < x1; x++) hist[small[y * sw + x]]++;
+
+  uint32_t total = (x1 - x0) * (y1 - y0);
+  uint64_t sum_all = 0;
+  for (int i = 0; i < 256; i++) sum_all += (uint64_t)i * hist[i];
+
+  uint64_t sum_bg = 0;
+  uint32_t w_bg = 0;
+  double best = -1;
+  int threshold = 128;
+  for (int t = 0; t < 256; t++) {
+    w_bg += hist[t];
+    if (w_bg == 0) continue;
+    uint32_t w_fg = total - w_bg;
+    if (w_fg == 0) break;
+    sum_bg += (uint64_t)t * hist[t];
+    double m_bg = (double)sum_bg / w_bg;
+    double m_fg = (double)(sum_all - sum_bg) / w_fg;
+    double between = (double)w_bg * w_fg * (m_bg - m_fg) * (m_bg - m_fg);
+    if (between > best) {
+      best = between;
+      threshold = t;
+    }
+  }
+  return threshold;
+}
+
+static uint16_t locator_find(uint16_t* parent, uint16_t l) {
+  while (parent[l] != l) {
+    parent[l] = parent[parent[l]];
+    l = parent[l];
+  }
+  return l;
+}
+
+// Bande des chiffres : lignes où l'énergie du gradient horizontal dépasse la moitié du pic
+static bool locator_find_strip(locator_work_t* work, int sw, int sh, int* y0, int* y1) {
+  uint32_t* profile = work->profile;
+  for (int y = 0; y < sh; y++) {
+    const uint8_t* row = work->small + y * sw;
+    uint32_t energy = 0;
+    for (int x = 0; x + 1 < sw; x++) {
+      int d = row[x + 1] - row[x];
+      energy += d < 0 ? -d : d;
+    }
+    profile[y] = energy;
+  }
+
+  // Lissage sur 5 lignes pour ne pas s'arrêter entre deux traits d'un même chiffre
+  uint32_t smooth[LOCATOR_MAX_H];
+  uint32_t peak = 0, low = UINT32_MAX;
+  int peak_y = 0;
+  for (int y = 0; y < sh; y++) {
+    uint32_t s = 0;
+    int n = 0;
+    for (int k = y - 2; k <= y + 2; k++) {
+      if (k >= 0 && k < sh) {
+        s += profile[k];
+        n++;
+      }
+    }
+    smooth[y] = s / n;
+    if (smooth[y] > peak) {
+      peak = smooth[y];
+      peak_y = y;
+    }
+    if (smooth[y] < low) low = smooth[y];
+  }
+  if (peak == 0) return false;
+
+  uint32_t threshold = low + (peak - low) / 2;
+  int top = peak_y, bottom = peak_y;
+  while (top > 0 && smooth[top - 1] > threshold) top--;
+  while (bottom + 1 < sh && smooth[bottom + 1] > threshold) bottom++;
+
+  *y0 = top > 0 ? top - 1 : 0;
+  *y1 = bottom + 2 < sh ? bottom + 2 : sh;
+  return (*y1 - *y0) >= 4 && (*y1 - *y0) <= LOCATOR_MAX_STRIP_H;
+}
+
+// Étendue horizontale de la fenêtre des chiffres : colonnes de la bande où l'énergie du
+// gradient vertical dépasse le quart du pic
+static bool locator_find_columns(locator_work_t* work, int sw, int y0, int y1, int* x0, int* x1) {
+  uint32_t* profile = work->profile;
+  uint32_t peak = 0;
+  for (int x = 0; x < sw; x++) {
+    uint32_t energy = 0;
+    for (int y = y0; y + 1 < y1; y++) {
+      int d = work->small[(y + 1) * sw + x] - work->small[y * sw + x];
+      energy += d < 0 ? -d : d;
+    }
+    profile[x] = energy;
+    if (energy > peak) peak = energy;
+  }
+  if (peak == 0) return false;
+
+  int left = 0, right = sw - 1;
+  while (left < sw && profile[left] * 4 < peak) left++;
+  while (right > left && profile[right] * 4 < peak) right--;
+
+  *x0 = left > 0 ? left - 1 : 0;
+  *x1 = right + 2 < sw ? right + 2 : sw;
+  return *x1 - *x0 >= NUM_DIGITS * 2;
+}
+
+// Composantes connexes (4-connexité, deux passes) des pixels « encre » de la zone
+static int locator_components(locator_work_t* work, int sw, int x0, int x1, int y0, int y1, int threshold,
+                              bool ink_is_dark, locator_component_t* comps) {
+  const int h = y1 - y0;
+  uint16_t* labels = work->labels;
+  uint16_t* parent = work->parent;
+  const int max_labels = LOCATOR_MAX_COMPONENTS * 4;
+  int next = 1;
+  parent[0] = 0;
+
+  for (int y = 0; y < h; y++) {
+    const uint8_t* row = work->small + (y0 + y) * sw;
+    for (int x = x0; x < x1; x++) {
+      bool ink = ink_is_dark ? row[x] <= threshold : row[x] > threshold;
+      uint16_t l = 0;
+      if (ink) {
+        uint16_t left = x > x0 ? labels[y * sw + x - 1] : 0;
+        uint16_t up = y > 0 ? labels[(y - 1) * sw + x] : 0;
+        if (left && up) {
+          uint16_t a = locator_find(parent, left), b = locator_find(parent, up);
+          l = a < b ? a : b;
+          parent[a > b ? a : b] = l;
+        } else if (left || up) {
+          l = left ? left : up;
+        } else if (next < max_labels) {
+          l = next;
+          parent[next] = next;
+          next++;
+        }
+      }
+      labels[y * sw + x] = l;
+    }
+  }
+
+  // Seconde passe : rectangle englobant de chaque racine
+  int count = 0;
+  uint16_t slot[LOCATOR_MAX_COMPONENTS * 4];
+  memset(slot, 0xff, sizeof(slot));
+  for (int y = 0; y < h; y++) {
+    for (int x = x0; x < x1; x++) {
+      uint16_t l = labels[y * sw + x];
+      if (!l) continue;
+      uint16_t r = locator_find(parent, l);
+      if (slot[r] == 0xffff) {
+        if (count >= LOCATOR_MAX_COMPONENTS) continue;
+        slot[r] = count;
+        comps[count].x0 = comps[count].x1 = x;
+        comps[count].y0 = comps[count].y1 = y;
+        comps[count].area = 0;
+        count++;
+      }
+      locator_component_t* c = &comps[slot[r]];
+      if (x < c->x0) c->x0 = x;
+      if (x > c->x1) c->x1 = x;
+      if (y < c->y0) c->y0 = y;
+      if (y > c->y1) c->y1 = y;
+      c->area++;
+    }
+  }
+  return count;
+}
+
+// Coupe une composante trop large (deux chiffres qui se touchent) au minimum du profil des colonnes
+static int locator_split_wide(locator_work_t* work, int sw, int y0, int threshold, bool ink_is_dark,
+                              locator_component_t* comps, int count, int max_w) {
+  int n = count;
+  for (int i = 0; i < count && n < LOCATOR_MAX_COMPONENTS; i++) {
+    locator_component_t* c = &comps[i];
+    int w = c->x1 - c->x0 + 1;
+    if (w <= max_w) continue;
+
+    int best_x = -1;
+    uint32_t best = UINT32_MAX;
+    for (int x = c->x0 + w / 4; x <= c->x1 - w / 4; x++) {
+      uint32_t ink = 0;
+      for (int y = y0 + c->y0; y <= y0 + c->y1; y++) {
+        uint8_t p = work->small[y * sw + x];
+        if (ink_is_dark ? p <= threshold : p > threshold) ink++;
+      }
+      if (ink < best) {
+        best = ink;
+        best_x = x;
+      }
+    }
+    if (best_x < 0) continue;
+
+    comps[n] = *c;
+    comps[n].x0 = best_x + 1;
+    comps[n].area = c->area / 2;
+    c->x1 = best_x - 1;
+    c->area -= comps[n].area;
+    n++;
+  }
+  return n;
+}
+
+// Centres de masse (1/16 px réduit) du gradient dans un cadre autour de la bande : une demi-hauteur
+// de bande au-dessus et au-dessous, une hauteur à gauche et à droite. Les colonnes des chiffres et
+// un quart de hauteur de part et d'autre (un 8 déborde de la boîte d'un 1) sont exclues. Lu
+// directement dans l'image pleine résolution un pixel sur LOCATOR_SCALE : quelques milliers de
+// lectures. Renvoie false si le cadre est trop uniforme pour situer la bande.
+static bool layout_signature(const uint8_t* frame, int width, int height, const digit_layout_t* layout,
+                             int32_t* row_center, int32_t* col_center) {
+  const int s = LOCATOR_SCALE;
+  const int h = layout->strip.h / s;
+  const int sx0 = layout->strip.x / s, sx1 = (layout->strip.x + layout->strip.w) / s;
+  const int sy0 = layout->strip.y / s, sy1 = (layout->strip.y + layout->strip.h) / s;
+  int x0 = sx0 - h, x1 = sx1 + h;
+  int y0 = sy0 - h / 2, y1 = sy1 + h / 2;
+  if (x0 < 0) x0 = 0;
+  if (y0 < 0) y0 = 0;
+  if (x1 > width / s - 1) x1 = width / s - 1;
+  if (y1 > height / s - 1) y1 = height / s - 1;
+  const int guard_x0 = sx0 - h / 4, guard_x1 = sx1 + h / 4;
+
+  uint64_t row_sum = 0, col_sum = 0, weight = 0;
+  uint32_t samples = 0;
+  for (int y = y0; y < y1; y++) {
+    const uint8_t* row = frame + (y * s) * width;
+    const uint8_t* below = row + s * width;
+    bool strip_row = y >= sy0 && y < sy1;
+    for (int x = x0; x < x1; x++) {
+      if (strip_row && x >= guard_x0 && x < guard_x1) {
+        x = guard_x1 - 1; // colonnes des chiffres sautées
+        continue;
+      }
+      int dx = row[(x + 1) * s] - row[x * s];
+      int dy = below[x * s] - row[x * s];
+      uint32_t g = (dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy);
+      row_sum += (uint64_t)g * y;
+      col_sum += (uint64_t)g * x;
+      weight += g;
+      samples++;
+    }
+  }
+  if (samples == 0 || weight < (uint64_t)samples * LOCATOR_MIN_TEXTURE) {
+    *row_center = *col_center = LOCATOR_NO_SIGNATURE;
+    return false;
+  }
+  *row_center = (int32_t)(row_sum * 16 / weight);
+  *col_center = (int32_t)(col_sum * 16 / weight);
+  return true;
+}
+
+// Localisation complète. Renvoie false (et laisse `layout` intact) si la bande ou
+// NUM_DIGITS chiffres n'ont pas été trouvés.
+static bool locate_digits(const uint8_t* frame, int width, int height, locator_work_t* work, digit_layout_t* layout) {
+  const int s = LOCATOR_SCALE;
+  int sw = width / s, sh = height / s;
+  if (sw > LOCATOR_MAX_W) sw = LOCATOR_MAX_W;
+  if (sh > LOCATOR_MAX_H) sh = LOCATOR_MAX_H;
+
+  locator_downscale(frame, width, work->small, sw, sh);
+
+  int x0, x1, y0, y1;
+  if (!locator_find_strip(work, sw, sh, &y0, &y1)) return false;
+  if (!locator_find_columns(work, sw, y0, y1, &x0, &x1)) return false;
+
+  // L'encre est la classe minoritaire : chiffres blancs sur rouleau noir ou l'inverse
+  int threshold = locator_otsu(work->small, sw, x0, y0, x1, y1);
+  uint32_t dark = 0;
+  for (int y = y0; y < y1; y++)
+    for (int x = x0; x < x1; x++) dark += work->small[y * sw + x] <= threshold;
+  bool ink_is_dark = dark * 2 < (uint32_t)((x1 - x0) * (y1 - y0));
+
+  locator_component_t comps[LOCATOR_MAX_COMPONENTS];
+  int count = locator_components(work, sw, x0, x1, y0, y1, threshold, ink_is_dark, comps);
+
+  // Un chiffre occupe au moins 40 % de la hauteur de la bande et n'est pas plus large qu'elle
+  const int strip_h = y1 - y0;
+  count = locator_split_wide(work, sw, y0, threshold, ink_is_dark, comps, count, strip_h);
+  int kept = 0;
+  for (int i = 0; i < count; i++) {
+    int ch = comps[i].y1 - comps[i].y0 + 1;
+    int cw = comps[i].x1 - comps[i].x0 + 1;
+    if (ch * 10 >= strip_h * 4 && cw >= 2 && cw <= strip_h) comps[kept++] = comps[i];
+  }
+  if (kept < NUM_DIGITS) return false;
+
+  // Les NUM_DIGITS plus grandes composantes, remises dans l'ordre de lecture
+  for (int i = 0; i < NUM_DIGITS; i++) {
+    for (int j = i + 1; j < kept; j++) {
+      if (comps[j].area > comps[i].area) {
+        locator_component_t t = comps[i];
+        comps[i] = comps[j];
+        comps[j] = t;
+      }
+    }
+  }
+  for (int i = 1; i < NUM_DIGITS; i++) {
+    locator_component_t c = comps[i];
+    int j = i - 1;
+    while (j >= 0 && comps[j].x0 > c.x0) {
+      comps[j + 1] = comps[j];
+      j--;
+    }
+    comps[j + 1] = c;
+  }
+
+  // Retour en pleine résolution, avec un pixel réduit de marge de chaque côté ;
+  // tous les chiffres prennent la hauteur de la bande (un rouleau à mi-course reste entier)
+  digit_layout_t found = *layout;
+  for (int i = 0; i < NUM_DIGITS; i++) {
+    int left = comps[i].x0 > 0 ? comps[i].x0 - 1 : 0;
+    int right = comps[i].x1 + 2 < sw ? comps[i].x1 + 2 : sw;
+    found.digits[i].x = left * s;
+    found.digits[i].w = (right - left) * s;
+    found.digits[i].y = y0 * s;
+    found.digits[i].h = strip_h * s;
+  }
+  found.strip.x = found.digits[0].x;
+  found.strip.y = y0 * s;
+  found.strip.w = found.digits[NUM_DIGITS - 1].x + found.digits[NUM_DIGITS - 1].w - found.strip.x;
+  found.strip.h = strip_h * s;
+  found.valid = true;
+  found.runs++;
+  layout_signature(frame, width, height, &found, &found.row_center, &found.col_center);
+
+  *layout = found;
+  return true;
+}
+
+// Vérifie la position de la bande en cache et ne relance la localisation que si elle a dérivé
+// (à chaque image si le cadre n'a pas donné de signature). Renvoie false si aucune disposition
+// valide n'est disponible.
+static bool update_digit_layout(const uint8_t* frame, int width, int height, locator_work_t* work,
+                                digit_layout_t* layout) {
+  if (layout->valid && layout->row_center != LOCATOR_NO_SIGNATURE) {
+    int32_t row_center, col_center;
+    layout->drift_checks++;
+    if (layout_signature(frame, width, height, layout, &row_center, &col_center)) {
+      int32_t dr = row_center - layout->row_center;
+      int32_t dc = col_center - layout->col_center;
+      if (dr <= LOCATOR_DRIFT_LIMIT && dr >= -LOCATOR_DRIFT_LIMIT &&
+          dc <= LOCATOR_DRIFT_LIMIT && dc >= -LOCATOR_DRIFT_LIMIT) {
+        return true;
+      }
+    }
+  }
+  return locate_digits(frame, width, height, work, layout) || layout->valid;
+}
+
+#endif // __DIGIT_LOCATOR_H__
@@ -0,0 +1,109 @@
+// Contrôle d'exposition en boucle fermée : l'histogramme de la ROI d'une image
+// sert à régler le rapport cyclique du flash pour l'image suivante.
+// Aucune dépendance Arduino : ce fichier compile aussi sur PC.
+
+#ifndef __EXPOSURE_H__
+#define __EXPOSURE_H__
+
+#include <stdint.h>
+
+#define EXPOSURE_HIST_BINS   32 // 256 niveaux regroupés par paquets de 8
+#define EXPOSURE_HIST_SHIFT  3
+#define EXPOSURE_SAMPLE_STEP 4  // un pixel sur 4 en x et en y suffit pour l'histogramme
+#define EXPOSURE_SATURATED   248
+
+typedef struct {
+  uint32_t bins[EXPOSURE_HIST_BINS];
+  uint32_t count;
+  uint32_t saturated; // pixels >= EXPOSURE_SATURATED
+} roi_histogram_t;
+
+typedef struct {
+  uint8_t target_low;             // la médiane de la ROI doit tomber dans [target_low, target_high]
+  uint8_t target_high;
+  uint16_t max_saturated_permille; // au-delà, reflet du flash : on baisse même si la médiane est correcte
+  int duty;                       // rapport cyclique courant du flash (0..max_duty)
+  int min_duty;
+  int max_duty;
+} exposure_ctrl_t;
+
+typedef enum {
+  EXPOSURE_OK,       // image dans la cible, on peut l'utiliser
+  EXPOSURE_ADJUSTED, // duty modifié, il faut une nouvelle image
+  EXPOSURE_LIMIT,    // hors cible mais le flash est déjà en butée : meilleure image possible
+} exposure_status_t;
+
+// Histogramme sous-échantillonné de la ROI [x_min, x_max[ x [y_min, y_max[ d'une image en niveaux de gris
+static void roi_histogram(const uint8_t* buf, int width, int height,
+                          int x_min, int y_min, int x_max, int y_max,
+                          roi_histogram_t* hist) {
+  if (x_min < 0) x_min = 0;
+  if (y_min < 0) y_min = 0;
+  if (x_max > width) x_max = width;
+  if (y_max > height) y_max = height;
+
+  for (int i = 0; i < EXPOSURE_HIST_BINS; i++) hist->bins[i] = 0;
+  hist->count = 0;
+  hist->saturated = 0;
+
+  for (int y = y_min; y < y_max; y += EXPOSURE_SAMPLE_STEP) {
+    const uint8_t* row = buf + y * width;
+    for (int x = x_min; x < x_max; x += EXPOSURE_SAMPLE_STEP) {
+      uint8_t p = row[x];
+      hist->bins[p >> EXPOSURE_HIST_SHIFT]++;
+      if (p >= EXPOSURE_SATURATED) hist->saturated++;
+    }
+  }
+  for (int i = 0; i < EXPOSURE_HIST_BINS; i++) hist->count += hist->bins[i];
+}
+
+// Niveau de gris (centre du paquet) sous lequel se trouvent `permille` pour mille des pixels
+static int histogram_percentile(const roi_histogram_t* hist, int permille) {
+  uint32_t limit = (uint64_t)hist->count * permille / 1000;
+  uint32_t seen = 0;
+  for (int i = 0; i < EXPOSURE_HIST_BINS; i++) {
+    seen += hist->bins[i];
+    if (seen > limit) return (i << EXPOSURE_HIST_SHIFT) + (1 << (EXPOSURE_HIST_SHIFT - 1));
+  }
+  return 255;
+}
+
+static int clamp_duty(const exposure_ctrl_t* ctrl, int duty) {
+  if (duty < ctrl->min_duty) return ctrl->min_duty;
+  if (duty > ctrl->max_duty) return ctrl->max_duty;
+  return duty;
+}
+
+// Met à jour le duty du flash à partir de l'histogramme de la dernière image.
+// La luminosité étant à peu près proportionnelle au duty, la correction est multiplicative.
+static exposure_status_t exposure_update(exposure_ctrl_t* ctrl, const roi_histogram_t* hist) {
+  if (hist->count == 0) return EXPOSURE_OK;
+
+  int median = histogram_percentile(hist, 500);
+  uint32_t saturated_permille = (uint64_t)hist->saturated * 1000 / hist->count;
+  int target = (ctrl->target_low + ctrl->target_high) / 2;
+  int duty = ctrl->duty;
+
+  if (saturated_permille > ctrl->max_saturated_permille) {
+    duty = duty * 3 / 4;
+  } else if (median < ctrl->target_low) {
+    // Un duty nul ne se corrige pas par multiplication : on repart du minimum
+    int base = duty > 0 ? duty : ctrl->min_duty;
+    duty = base * target / (median > 0 ? median : 1);
+    if (duty > base * 4) duty = base * 4;
+    if (duty <= ctrl->duty) duty = ctrl->duty + 1;
+  } else if (median > ctrl->target_high) {
+    duty = duty * target / median;
+    if (duty < ctrl->duty / 4) duty = ctrl->duty / 4;
+    if (duty >= ctrl->duty) duty = ctrl->duty - 1;
+  } else {
+    return EXPOSURE_OK;
+  }
+
+  duty = clamp_duty(ctrl, duty);
+  if (duty == ctrl->duty) return EXPOSURE_LIMIT;
+  ctrl->duty = duty;
+  return EXPOSURE_ADJUSTED;
+}
+
+#endif // __EXPOSURE_H__
@@ -0,0 +1,93 @@
+// Contrôle qualité d'une image avant inférence, en une seule passe sur la bande des chiffres :
+//  - netteté : variance du laplacien (roue en mouvement -> flou -> variance faible)
+//  - reflet : proportion de pixels saturés (flash sur la vitre du compteur)
+//  - exposition : niveau moyen
+// Aucune dépendance Arduino : ce fichier compile aussi sur PC.
+
+#ifndef __FRAME_QUALITY_H__
+#define __FRAME_QUALITY_H__
+
+#include <stdint.h>
+
+#define QUALITY_SAMPLE_STEP 2   // un pixel sur 2 en x et en y
+#define QUALITY_SATURATED   248
+
+typedef struct {
+  uint8_t mean;
+  uint32_t sharpness;          // variance du laplacien 4-voisins
+  uint16_t saturated_permille;
+} frame_quality_t;
+
+typedef struct {
+  uint32_t min_sharpness;
+  uint16_t max_saturated_permille;
+  uint8_t min_mean;
+  uint8_t max_mean;
+} quality_limits_t;
+
+typedef enum {
+  QUALITY_OK,
+  QUALITY_BLURRED,
+  QUALITY_GLARE,
+  QUALITY_DARK,
+  QUALITY_BRIGHT,
+} quality_verdict_t;
+
+static const char* quality_verdict_name(quality_verdict_t verdict) {
+  switch (verdict) {
+    case QUALITY_OK: return "ok";
+    case QUALITY_BLURRED: return "blurred";
+    case QUALITY_GLARE: return "glare";
+    case QUALITY_DARK: return "dark";
+    case QUALITY_BRIGHT: return "bright";
+  }
+  return "unknown";
+}
+
+// Mesure la qualité de la zone [x_min, x_max[ x [y_min, y_max[ (le bord d'un pixel sert au laplacien)
+static void measure_frame_quality(const uint8_t* buf, int width, int height,
+                                  int x_min, int y_min, int x_max, int y_max,
+                                  frame_quality_t* quality) {
+  if (x_min < 1) x_min = 1;
+  if (y_min < 1) y_min = 1;
+  if (x_max > width - 1) x_max = width - 1;
+  if (y_max > height - 1) y_max = height - 1;
+
+  uint32_t count = 0, saturated = 0;
+  uint64_t sum = 0;
+  int64_t lap_sum = 0;
+  uint64_t lap_sq = 0;
+  for (int y = y_min; y < y_max; y += QUALITY_SAMPLE_STEP) {
+    const uint8_t* row = buf + y * width;
+    for (int x = x_min; x < x_max; x += QUALITY_SAMPLE_STEP) {
+      int p = row[x];
+      int lap = 4 * p - row[x - 1] - row[x + 1] - row[x - width] - row[x + width];
+      sum += p;
+      lap_sum += lap;
+      lap_sq += (uint64_t)(lap * lap);
+      saturated += p >= QUALITY_SATURATED;
+      count++;
+    }
+  }
+
+  if (count == 0) {
+    quality->mean = 0;
+    quality->sharpness = 0;
+    quality->saturated_permille = 0;
+    return;
+  }
+  int64_t lap_mean = lap_sum / (int64_t)count;
+  quality->mean = sum / count;
+  quality->sharpness = (uint32_t)(lap_sq / count - lap_mean * lap_mean);
+  quality->saturated_permille = (uint64_t)saturated * 1000 / count;
+}
+
+static quality_verdict_t judge_frame_quality(const frame_quality_t* quality, const quality_limits_t* limits) {
+  if (quality->mean < limits->min_mean) return QUALITY_DARK;
+  if (quality->mean > limits->max_mean) return QUALITY_BRIGHT;
+  if (quality->saturated_permille > limits->max_saturated_permille) return QUALITY_GLARE;
+  if (quality->sharpness < limits->min_sharpness) return QUALITY_BLURRED;
+  return QUALITY_OK;
+}
+
+#endif // __FRAME_QUALITY_H__
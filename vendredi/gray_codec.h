@@ -0,0 +1,151 @@
+// Encodages sans perte et compacts des images en niveaux de gris, pour récupérer des
+// recadrages nets (ré-étiquetage de digits/) sans les artefacts du JPEG :
+//  - QOG : variante niveaux de gris de QOI (répétitions, table des niveaux récents, petites différences)
+//  - BIT : 1 bit par pixel après binarisation, comme les entrées du modèle
+// La sortie passe par un petit tampon et un callback de même forme que celui de frame2jpg_cb,
+// pour être envoyée morceau par morceau. captureDecode.py relit les deux formats sur PC.
+// Aucune dépendance Arduino : ce fichier compile aussi sur PC.
+//
+// Format QOG : "QOG1", largeur et hauteur (uint16 petit-boutiste), puis des opérations :
+//   00aaabbb            deux pixels, différences a-4 puis b-4 (-4..3) : le bruit du capteur
+//   01dddddd            différence d-32 avec le pixel précédent (-32..31)
+//   10rrrrrr            répétition du pixel précédent r+1 fois (1..64)
+//   11iiiiii            niveau rangé à l'indice i (< 63) de la table (indice = niveau * 7 % 63)
+//   11111111 vvvvvvvv   niveau v en clair
+// Le pixel « précédent » vaut 0 au départ, la table est remplie de zéros et chaque pixel
+// qui n'est pas une répétition y est rangé.
+// Format BIT : "BIT1", largeur, hauteur, seuil (1 octet), puis les lignes, 8 pixels par octet,
+// bit de poids fort en premier, chaque ligne complétée à l'octet ; 1 = pixel > seuil.
+
+#ifndef __GRAY_CODEC_H__
+#define __GRAY_CODEC_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CODEC_CHUNK_SIZE 512
+
+#define QOG_OP_DIFF2 0x00
+#define QOG_OP_DIFF  0x40
+#define QOG_OP_RUN   0x80
+#define QOG_OP_INDEX 0xc0
+#define QOG_OP_LIT   0xff
+#define QOG_HASH(v)  (((v) * 7) % 63)
+
+// Même signature que jpg_out_cb : renvoie le nombre d'octets acceptés
+typedef size_t (*codec_out_cb)(void* arg, size_t index, const void* data, size_t len);
+
+typedef struct {
+  uint8_t buf[CODEC_CHUNK_SIZE];
+  size_t used;
+  size_t index; // octets déjà envoyés
+  codec_out_cb cb;
+  void* arg;
+  bool failed;
+} codec_writer_t;
+
+static void codec_flush(codec_writer_t* w) {
+  if (w->used && !w->failed) {
+    if (w->cb(w->arg, w->index, w->buf, w->used) != w->used) w->failed = true;
+    w->index += w->used;
+  }
+  w->used = 0;
+}
+
+static inline void codec_put(codec_writer_t* w, uint8_t byte) {
+  w->buf[w->used++] = byte;
+  if (w->used == CODEC_CHUNK_SIZE) codec_flush(w);
+}
+
+static void codec_header(codec_writer_t* w, const char* magic, int width, int height) {
+  for (int i = 0; i < 4; i++) codec_put(w, magic[i]);
+  codec_put(w, width & 0xff);
+  codec_put(w, width >> 8);
+  codec_put(w, height & 0xff);
+  codec_put(w, height >> 8);
+}
+
+static bool qog_encode_cb(const uint8_t* pixels, int width, int height, codec_out_cb cb, void* arg) {
+  codec_writer_t w;
+  w.used = 0;
+  w.index = 0;
+  w.cb = cb;
+  w.arg = arg;
+  w.failed = false;
+  codec_header(&w, "QOG1", width, height);
+
+  uint8_t index[63] = { 0 };
+  uint8_t prev = 0;
+  int run = 0;
+  const size_t count = (size_t)width * height;
+  for (size_t i = 0; i < count && !w.failed; i++) {
+    uint8_t v = pixels[i];
+    if (v == prev) {
+      if (++run == 64) {
+        codec_put(&w, QOG_OP_RUN | (run - 1));
+        run = 0;
+      }
+      continue;
+    }
+    if (run) {
+      codec_put(&w, QOG_OP_RUN | (run - 1));
+      run = 0;
+    }
+
+    int diff = v - prev;
+    if (diff >= -4 && diff <= 3 && i + 1 < count) {
+      int next_diff = pixels[i + 1] - v;
+      if (next_diff >= -4 && next_diff <= 3) {
+        codec_put(&w, QOG_OP_DIFF2 | ((diff + 4) << 3) | (next_diff + 4));
+        index[QOG_HASH(v)] = v;
+        prev = pixels[++i];
+        index[QOG_HASH(prev)] = prev;
+        continue;
+      }
+    }
+
+    int h = QOG_HASH(v);
+    if (index[h] == v) {
+      codec_put(&w, QOG_OP_INDEX | h);
+    } else if (diff >= -32 && diff <= 31) {
+      codec_put(&w, QOG_OP_DIFF | (diff + 32));
+    } else {
+      codec_put(&w, QOG_OP_LIT);
+      codec_put(&w, v);
+    }
+    index[h] = v;
+    prev = v;
+  }
+  if (run) codec_put(&w, QOG_OP_RUN | (run - 1));
+  codec_flush(&w);
+  return !w.failed;
+}
+
+static bool bitpack_encode_cb(const uint8_t* pixels, int width, int height, uint8_t threshold,
+                              codec_out_cb cb, void* arg) {
+  codec_writer_t w;
+  w.used = 0;
+  w.index = 0;
+  w.cb = cb;
+  w.arg = arg;
+  w.failed = false;
+  codec_header(&w, "BIT1", width, height);
+  codec_put(&w, threshold);
+
+  for (int y = 0; y < height && !w.failed; y++) {
+    const uint8_t* row = pixels + (size_t)y * width;
+    uint8_t byte = 0;
+    for (int x = 0; x < width; x++) {
+      byte = (byte << 1) | (row[x] > threshold);
+      if ((x & 7) == 7) {
+        codec_put(&w, byte);
+        byte = 0;
+      }
+    }
+    if (width & 7) codec_put(&w, byte << (8 - (width & 7)));
+  }
+  codec_flush(&w);
+  return !w.failed;
+}
+
+#endif // __GRAY_CODEC_H__
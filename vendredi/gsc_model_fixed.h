@@ -2574,6 +2574,15 @@ extern "C" {
 #endif
 
 
+// Points d'accroche autour de chaque couche (mesure des durées par couche), vides par défaut.
+// Ajout manuel au code généré : à reporter si le modèle est régénéré.
+#ifndef MODEL_LAYER_BEGIN
+#define MODEL_LAYER_BEGIN(layer)
+#endif
+#ifndef MODEL_LAYER_END
+#define MODEL_LAYER_END(layer)
+#endif
+
 void cnn(
   const input_t input,
   dense_3_output_type dense_3_output) {
@@ -2595,54 +2604,68 @@ void cnn(
 // Model layers call chain 
   
   
+  MODEL_LAYER_BEGIN(conv2d_2);
   conv2d_2( // First layer uses input passed as model parameter
     input,
     conv2d_2_kernel,
     conv2d_2_bias,
     activations1.conv2d_2_output
     );
+  MODEL_LAYER_END(conv2d_2);
   
   
+  MODEL_LAYER_BEGIN(max_pooling2d_2);
   max_pooling2d_2(
     activations1.conv2d_2_output,
     activations2.max_pooling2d_2_output
     );
+  MODEL_LAYER_END(max_pooling2d_2);
   
   
+  MODEL_LAYER_BEGIN(conv2d_3);
   conv2d_3(
     activations2.max_pooling2d_2_output,
     conv2d_3_kernel,
     conv2d_3_bias,
     activations1.conv2d_3_output
     );
+  MODEL_LAYER_END(conv2d_3);
   
   
+  MODEL_LAYER_BEGIN(max_pooling2d_3);
   max_pooling2d_3(
     activations1.conv2d_3_output,
     activations2.max_pooling2d_3_output
     );
+  MODEL_LAYER_END(max_pooling2d_3);
   
   
+  MODEL_LAYER_BEGIN(flatten_1);
   flatten_1(
     activations2.max_pooling2d_3_output,
     activations2.flatten_1_output
     );
+  MODEL_LAYER_END(flatten_1);
   
   
+  MODEL_LAYER_BEGIN(dense_2);
   dense_2(
     activations2.flatten_1_output,
     dense_2_kernel,
     dense_2_bias,
     activations1.dense_2_output
     );
+  MODEL_LAYER_END(dense_2);
   
   
+  MODEL_LAYER_BEGIN(dense_3);
   dense_3(
     activations1.dense_2_output,
     dense_3_kernel,
     dense_3_bias,// Last layer uses output passed as model parameter
     dense_3_output
     );
+  MODEL_LAYER_END(dense_3);
 }
 
 #ifdef __cplusplus
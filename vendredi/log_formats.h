@@ -0,0 +1,37 @@
+// Table des messages du journal différé (voir log_ring.h) : nom de l'identifiant et format
+// printf, avec au plus quatre entiers (%d, %u, %x). logDecode.py relit cette table pour décoder
+// /log : ajouter les nouveaux messages en fin de table, sans renuméroter les autres.
+
+#ifndef __LOG_FORMATS_H__
+#define __LOG_FORMATS_H__
+
+#define LOG_FORMATS(X) \
+  X(LOG_CROP_SIZE,        "Crop: %dx%d") \
+  X(LOG_CROP_TOO_LARGE,   "Cropped image larger than its buffer (%d bytes)") \
+  X(LOG_CAPTURE_FAILED,   "Camera capture failed") \
+  X(LOG_CAPTURE_STATS,    "Stale frames dropped: %u, digit layout: %d us (%u full runs)") \
+  X(LOG_CROP_FAILED,      "Failed to crop image") \
+  X(LOG_FRAME_REJECTED,   "Frame rejected: verdict %d (mean %d, sharpness %u, saturated %d/1000)") \
+  X(LOG_DIGIT,            "Digit %d: class %d, score %d") \
+  X(LOG_ENCODING_FAILED,  "Image encoding failed") \
+  X(LOG_STREAM_FAILED,    "Stream: camera capture failed") \
+  X(LOG_STREAM_JPEG,      "Stream: JPEG compression failed") \
+  X(LOG_READING_OK,       "Reading %u done: %u") \
+  X(LOG_READING_FAILED,   "Reading failed") \
+  X(LOG_WIFI_READY,       "Camera Stream Ready! Go to: http://%u.%u.%u.%u") \
+  X(LOG_BOOT,             "Boot: camera %u us, server %u us, IP %u us (cached Wi-Fi: %d)") \
+  X(LOG_WIFI_FAST_FAILED, "Wi-Fi: cached channel and BSSID failed (reason %d), scanning") \
+  X(LOG_PUBLISH,          "Publish: HTTP %d for reading %u") \
+  X(LOG_SLEEP,            "Sleep: wake %u, reading at %u us, awake %d ms") \
+  X(LOG_METER,            "Meter: %u (verdict %d, %d digits read)") \
+  X(LOG_WHEEL,            "Wheel: position %d thousandths of a unit (confidence %d, shift %d rows, rolling %d)") \
+  X(LOG_WIFI_GATEWAY_FAILED, "Wi-Fi: cached IP, gateway %u.%u.%u.%u unreachable, back to DHCP")
+
+#define LOG_FORMAT_ID(id, format) id,
+typedef enum {
+  LOG_FORMATS(LOG_FORMAT_ID)
+  LOG_FORMAT_COUNT
+} log_format_id_t;
+#undef LOG_FORMAT_ID
+
+#endif // __LOG_FORMATS_H__
@@ -0,0 +1,142 @@
+// Journal différé : le chemin de capture n'écrit qu'un enregistrement binaire de taille fixe
+// (identifiant de format, quatre entiers, horodatage) dans un anneau, sans formatage ni attente
+// de la liaison série. Une tâche de basse priorité formate et affiche plus tard, et /log renvoie
+// l'anneau brut, décodé sur PC par logDecode.py avec la table de log_formats.h.
+//  - plusieurs tâches écrivent : un fetch_add réserve la case, comme pour la trace ;
+//  - chaque case porte un numéro de séquence (indice + 1, 0 pendant l'écriture) : le lecteur
+//    reconnaît une case pas encore écrite ou déjà réécrite par un tour suivant ;
+//  - un écrivain prend la case par compare-exchange avant d'y écrire : si l'anneau fait un tour
+//    pendant qu'un écrivain préempté la tient, le suivant abandonne son message (noté dans la case
+//    pour que le lecteur le compte comme perdu) au lieu de mélanger deux enregistrements ;
+//  - anneau plein : les plus anciens messages sont écrasés et comptés comme perdus, l'écriture
+//    ne bloque jamais.
+// Aucune dépendance Arduino : ce fichier compile aussi sur PC.
+
+#ifndef __LOG_RING_H__
+#define __LOG_RING_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#define LOG_ARGS 4
+#define LOG_FREE 0xffffffffu // numéro de séquence d'une case jamais écrite (plus ancien que tout)
+
+// Format de /log (petit-boutiste) : en-tête "LOG1", taille d'un enregistrement (uint16), taille de
+// la table des formats (uint16), messages écrits depuis le démarrage (uint32), puis les
+// enregistrements jusqu'à la fin de la réponse
+typedef struct {
+  uint32_t us;           // 32 bits de poids faible de l'horloge µs
+  uint16_t id;           // indice dans la table de log_formats.h
+  uint8_t core;
+  uint8_t unused;
+  int32_t args[LOG_ARGS];
+} log_record_t;
+
+typedef struct {
+  std::atomic<uint32_t> seq;
+  std::atomic<uint32_t> dropped; // indice + 1 du dernier message abandonné sur cette case
+  log_record_t record;
+} log_slot_t;
+
+typedef struct {
+  log_slot_t* slots;     // anneau alloué par l'appelant
+  uint32_t mask;         // capacité - 1, capacité en puissance de 2
+  std::atomic<uint32_t> head;
+} log_ring_t;
+
+// Lecteur de l'anneau : position et messages perdus depuis le début
+typedef struct {
+  uint32_t tail;
+  uint32_t lost;
+} log_cursor_t;
+
+static bool log_init(log_ring_t* l, log_slot_t* slots, uint32_t capacity) {
+  l->head.store(0);
+  if (!slots || capacity == 0 || (capacity & (capacity - 1))) {
+    l->slots = NULL;
+    l->mask = 0;
+    return false;
+  }
+  for (uint32_t i = 0; i < capacity; i++) {
+    slots[i].seq.store(LOG_FREE);
+    slots[i].dropped.store(0);
+  }
+  l->slots = slots;
+  l->mask = capacity - 1;
+  return true;
+}
+
+static inline void log_write(log_ring_t* l, uint16_t id, uint32_t us, uint8_t core,
+                             int32_t a0, int32_t a1, int32_t a2, int32_t a3) {
+  if (!l->slots) return;
+  uint32_t index = l->head.fetch_add(1, std::memory_order_relaxed);
+  log_slot_t* s = &l->slots[index & l->mask];
+  // Case libre seulement si elle n'est pas en cours d'écriture et porte un message plus ancien
+  uint32_t seq = s->seq.load(std::memory_order_relaxed);
+  if (seq == 0 || (seq != LOG_FREE && seq - (index + 1) < 0x80000000u) ||
+      !s->seq.compare_exchange_strong(seq, 0, std::memory_order_relaxed)) {
+    // Garde l'abandon le plus récent : un écrivain en retard ne doit pas masquer celui attendu
+    uint32_t last = s->dropped.load(std::memory_order_relaxed);
+    while (last - (index + 1) > 0x80000000u &&
+           !s->dropped.compare_exchange_weak(last, index + 1, std::memory_order_release)) {
+    }
+    return;
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  s->record.us = us;
+  s->record.id = id;
+  s->record.core = core;
+  s->record.unused = 0;
+  s->record.args[0] = a0;
+  s->record.args[1] = a1;
+  s->record.args[2] = a2;
+  s->record.args[3] = a3;
+  s->seq.store(index + 1, std::memory_order_release);
+}
+
+// Lit l'enregistrement suivant du curseur. Renvoie false s'il n'y a plus rien de prêt ; une case
+// réécrite entre-temps est sautée et comptée comme perdue.
+static bool log_read(log_ring_t* l, log_cursor_t* c, log_record_t* out) {
+  if (!l->slots) return false;
+  for (;;) {
+    uint32_t head = l->head.load(std::memory_order_acquire);
+    if (head - c->tail > l->mask + 1) {
+      c->lost += head - c->tail - (l->mask + 1);
+      c->tail = head - (l->mask + 1);
+    }
+    if (c->tail == head) return false;
+
+    const log_slot_t* s = &l->slots[c->tail & l->mask];
+    uint32_t seq = s->seq.load(std::memory_order_acquire);
+    if (seq != c->tail + 1) {
+      bool pending = seq == 0 || seq == LOG_FREE || seq - (c->tail + 1) > 0x80000000u;
+      if (pending && s->dropped.load(std::memory_order_acquire) != c->tail + 1) {
+        return false; // écriture en cours ou pas encore commencée
+      }
+      c->lost++;      // déjà réécrite, ou message abandonné par son écrivain
+      c->tail++;
+      continue;
+    }
+    memcpy(out, &s->record, sizeof(*out));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (s->seq.load(std::memory_order_relaxed) != seq) {
+      c->lost++;
+      c->tail++;
+      continue;
+    }
+    c->tail++;
+    return true;
+  }
+}
+
+// Curseur placé sur le plus ancien enregistrement encore dans l'anneau
+static log_cursor_t log_oldest(log_ring_t* l) {
+  uint32_t head = l->head.load(std::memory_order_acquire);
+  log_cursor_t c;
+  c.tail = head > l->mask + 1 ? head - (l->mask + 1) : 0;
+  c.lost = 0;
+  return c;
+}
+
+#endif // __LOG_RING_H__
@@ -0,0 +1,51 @@
+// Relevés mémoire autour des étapes du pipeline : tas libre, plus grand bloc libre (la
+// fragmentation se voit quand il baisse alors que le tas libre ne bouge pas) et marge de pile
+// de la tâche. On garde les extrêmes depuis le démarrage pour connaître la marge réelle avant
+// d'ajouter un tampon ou une image au driver.
+// Chaque étape n'est exécutée que par une tâche à la fois ; le lecteur (/metrics) tolère un
+// relevé en cours de mise à jour.
+// Aucune dépendance Arduino : ce fichier compile aussi sur PC.
+
+#ifndef __MEMORY_STATS_H__
+#define __MEMORY_STATS_H__
+
+#include <stdint.h>
+
+typedef struct {
+  uint32_t free_bytes;    // tas interne libre
+  uint32_t largest_block; // plus grand bloc allouable d'un seul tenant
+  uint32_t stack_free;    // marge minimale de pile de la tâche depuis son démarrage
+} memory_sample_t;
+
+typedef struct {
+  bool valid;
+  uint32_t samples;
+  memory_sample_t min;
+  memory_sample_t max;
+  int32_t max_drop;       // plus forte baisse du tas libre entre le début et la fin de l'étape
+} memory_watch_t;
+
+static void memory_watch_add(memory_watch_t* w, const memory_sample_t* s) {
+  if (!w->valid) {
+    w->min = *s;
+    w->max = *s;
+    w->valid = true;
+  }
+  if (s->free_bytes < w->min.free_bytes) w->min.free_bytes = s->free_bytes;
+  if (s->largest_block < w->min.largest_block) w->min.largest_block = s->largest_block;
+  if (s->stack_free < w->min.stack_free) w->min.stack_free = s->stack_free;
+  if (s->free_bytes > w->max.free_bytes) w->max.free_bytes = s->free_bytes;
+  if (s->largest_block > w->max.largest_block) w->max.largest_block = s->largest_block;
+  if (s->stack_free > w->max.stack_free) w->max.stack_free = s->stack_free;
+  w->samples++;
+}
+
+// Relevés pris au début et à la fin d'une même exécution de l'étape
+static void memory_watch_stage(memory_watch_t* w, const memory_sample_t* before, const memory_sample_t* after) {
+  memory_watch_add(w, before);
+  memory_watch_add(w, after);
+  int32_t drop = (int32_t)before->free_bytes - (int32_t)after->free_bytes;
+  if (drop > w->max_drop) w->max_drop = drop;
+}
+
+#endif // __MEMORY_STATS_H__
@@ -0,0 +1,171 @@
+// Assemblage des chiffres en index du compteur, avec les règles d'un totalisateur à rouleaux :
+//  - l'index ne diminue jamais et progresse d'au plus `max_delta` entre deux lectures ;
+//  - un chiffre ne change que si celui de droite vient de faire un tour (passage de 9 à 0).
+// Le classifieur n'est donc lancé que sur les chiffres qui peuvent avoir changé : d'abord les
+// unités, puis un chiffre de plus à chaque retenue. Tous les chiffres sont relus si un score est
+// ambigu, s'il n'y a pas encore d'index de référence, ou au moins toutes les `full_every` lectures.
+// Parmi les index plausibles, on retient celui dont la somme des scores (sorties de dense_3)
+// est la plus forte ; une lecture qui ne colle à aucun index plausible est rejetée, sauf si
+// `rebase_after` lectures de suite donnent le même index (compteur remplacé, longue coupure).
+// Aucune dépendance Arduino : ce fichier compile aussi sur PC.
+
+#ifndef __METER_DECODER_H__
+#define __METER_DECODER_H__
+
+#include <stdint.h>
+#include "digit_locator.h" // NUM_DIGITS
+
+#define METER_CLASSES 10
+
+typedef struct {
+  int16_t min_margin;       // écart minimal entre les deux meilleurs scores pour se fier à un chiffre
+  int32_t reject_margin;    // perte de score au-delà de laquelle l'index plausible est refusé
+  uint32_t max_delta;       // progression maximale entre deux lectures acceptées
+  uint16_t full_every;      // relecture de tous les chiffres au moins toutes les N lectures
+  uint8_t rebase_after;     // lectures rejetées identiques avant d'adopter le nouvel index
+} meter_rules_t;
+
+typedef struct {
+  bool valid;               // un index de référence est connu
+  uint32_t value;           // dernier index accepté
+  uint16_t since_full;      // lectures depuis la dernière relecture complète
+  uint8_t rejected;         // lectures rejetées de suite...
+  uint32_t rejected_value;  // ...qui donnaient toutes cet index
+} meter_state_t;
+
+typedef enum {
+  METER_ACCEPTED,           // index plausible, éventuellement corrigé par les règles
+  METER_REBASED,            // nouvel index de référence (premier index, ou rejets répétés)
+  METER_REJECTED,           // aucun index plausible ne correspond aux chiffres lus
+} meter_verdict_t;
+
+static const char* meter_verdict_name(meter_verdict_t verdict) {
+  switch (verdict) {
+    case METER_ACCEPTED: return "accepted";
+    case METER_REBASED: return "rebased";
+    case METER_REJECTED: return "rejected";
+  }
+  return "unknown";
+}
+
+// Scores des chiffres lus ; seuls les chiffres de `first` aux unités sont renseignés
+typedef int16_t meter_scores_t[NUM_DIGITS][METER_CLASSES];
+
+static int meter_digit(uint32_t value, int d) {
+  for (int i = NUM_DIGITS - 1; i > d; i--) value /= 10;
+  return (int)(value % 10);
+}
+
+static int meter_best(const int16_t* scores, int16_t* margin) {
+  int best = 0, second = -1;
+  for (int c = 1; c < METER_CLASSES; c++) {
+    if (scores[c] > scores[best]) {
+      second = best;
+      best = c;
+    } else if (second < 0 || scores[c] > scores[second]) {
+      second = c;
+    }
+  }
+  *margin = scores[best] - scores[second];
+  return best;
+}
+
+static uint32_t meter_range() {
+  uint32_t range = 1;
+  for (int d = 0; d < NUM_DIGITS; d++) range *= 10;
+  return range;
+}
+
+// Avec les chiffres lus de `first` aux unités, renvoie le chiffre le plus à gauche qu'il faut lire
+// (`first` si rien de plus n'est nécessaire)
+static int meter_digits_needed(const meter_rules_t* rules, const meter_state_t* state,
+                               const meter_scores_t scores, int first) {
+  if (!state->valid || state->rejected > 0 || state->since_full + 1 >= rules->full_every) return 0;
+  for (int d = first; d < NUM_DIGITS; d++) {
+    int16_t margin;
+    meter_best(scores[d], &margin);
+    if (margin < rules->min_margin) return 0;
+  }
+  // Retenues, des unités vers la gauche : un chiffre lu plus petit que l'ancien a fait un tour
+  for (int d = NUM_DIGITS - 1; d >= first; d--) {
+    int16_t margin;
+    if (meter_best(scores[d], &margin) >= meter_digit(state->value, d)) return first;
+  }
+  return first > 0 ? first - 1 : 0;
+}
+
+// Choisit l'index parmi ceux compatibles avec l'index précédent. Les chiffres à gauche de `first`
+// n'ont pas été lus et sont repris de l'index précédent.
+static meter_verdict_t meter_decode(const meter_rules_t* rules, meter_state_t* state,
+                                    const meter_scores_t scores, int first, uint32_t* value) {
+  // Index lu sans contrainte
+  uint32_t read_value = 0;
+  int32_t read_score = 0;
+  for (int d = 0; d < NUM_DIGITS; d++) {
+    int digit;
+    if (d < first) {
+      digit = meter_digit(state->value, d);
+    } else {
+      int16_t margin;
+      digit = meter_best(scores[d], &margin);
+      read_score += scores[d][digit];
+    }
+    read_value = read_value * 10 + digit;
+  }
+  state->since_full = first == 0 ? 0 : state->since_full + 1;
+
+  if (!state->valid) {
+    state->valid = true;
+    state->value = read_value;
+    state->rejected = 0;
+    *value = read_value;
+    return METER_REBASED;
+  }
+
+  // Meilleur index plausible : pas de retour en arrière, progression bornée, chiffres non lus inchangés
+  uint32_t range = meter_range();
+  uint32_t best_value = state->value;
+  int32_t best_score = INT32_MIN;
+  for (uint32_t delta = 0; delta <= rules->max_delta && delta < range; delta++) {
+    uint32_t candidate = (state->value + delta) % range; // le totalisateur reboucle à 9999
+    int32_t score = 0;
+    bool possible = true;
+    for (int d = 0; d < NUM_DIGITS && possible; d++) {
+      int digit = meter_digit(candidate, d);
+      if (d < first) {
+        possible = digit == meter_digit(state->value, d);
+      } else {
+        score += scores[d][digit];
+      }
+    }
+    if (possible && score > best_score) {
+      best_score = score;
+      best_value = candidate;
+    }
+  }
+
+  if (best_score != INT32_MIN && read_score - best_score <= rules->reject_margin) {
+    state->value = best_value;
+    state->rejected = 0;
+    *value = best_value;
+    return METER_ACCEPTED;
+  }
+
+  // Lecture impossible : le même index lu plusieurs fois de suite devient la nouvelle référence
+  if (state->rejected > 0 && state->rejected_value == read_value) {
+    state->rejected++;
+  } else {
+    state->rejected = 1;
+    state->rejected_value = read_value;
+  }
+  if (first == 0 && state->rejected >= rules->rebase_after) {
+    state->value = read_value;
+    state->rejected = 0;
+    *value = read_value;
+    return METER_REBASED;
+  }
+  *value = state->value;
+  return METER_REJECTED;
+}
+
+#endif // __METER_DECODER_H__
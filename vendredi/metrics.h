@@ -0,0 +1,100 @@
+// Histogrammes de latence à seaux fixes et compteurs, rendus au format texte de Prometheus.
+// Les seaux et _count sont des incréments atomiques 32 bits, natifs et sans verrou sur l'ESP32.
+// La somme est en 64 bits : sur Xtensa, libatomic la protège par un verrou (section critique
+// très courte), seul point non lock-free d'une observation ; le pipeline n'attend jamais /metrics.
+// La lecture n'est pas un instantané strict (un seau peut compter une observation de plus que
+// _count), ce que Prometheus tolère.
+// Aucune dépendance Arduino : ce fichier compile aussi sur PC.
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <atomic>
+
+#define METRICS_BUCKETS 14
+
+// Bornes supérieures des seaux, en µs : de 50 µs (une couche dense) à 1 s (capture avec
+// retentatives)
+static const uint32_t metrics_bucket_us[METRICS_BUCKETS] = {
+  50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000,
+};
+
+typedef struct {
+  std::atomic<uint32_t> buckets[METRICS_BUCKETS + 1]; // non cumulés, le dernier pour +Inf
+  std::atomic<uint32_t> count;
+  std::atomic<uint64_t> sum_us; // 32 bits reboucleraient après ~71 min de latence cumulée
+} latency_histogram_t;
+
+// Reçoit le texte produit, morceau par morceau
+typedef void (*metrics_out_cb)(void* arg, const char* text, size_t len);
+
+static void histogram_observe(latency_histogram_t* h, int64_t us) {
+  uint32_t v = us < 0 ? 0 : (uint32_t)us;
+  int b = 0;
+  while (b < METRICS_BUCKETS && v > metrics_bucket_us[b]) b++;
+  h->buckets[b].fetch_add(1, std::memory_order_relaxed);
+  h->sum_us.fetch_add(v, std::memory_order_relaxed);
+  h->count.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Durée en secondes, sans passer par les flottants de printf
+static int metrics_format_seconds(char* out, size_t size, uint64_t us) {
+  return snprintf(out, size, "%llu.%06u", (unsigned long long)(us / 1000000), (unsigned)(us % 1000000));
+}
+
+static void metrics_write_family(metrics_out_cb cb, void* arg, const char* name, const char* type,
+                                 const char* help) {
+  char line[160];
+  int len = snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+  if (len > (int)sizeof(line) - 1) len = sizeof(line) - 1;
+  cb(arg, line, len);
+}
+
+static void metrics_write_value(metrics_out_cb cb, void* arg, const char* name, uint32_t value) {
+  char line[96];
+  int len = snprintf(line, sizeof(line), "%s %u\n", name, (unsigned)value);
+  if (len > (int)sizeof(line) - 1) len = sizeof(line) - 1;
+  cb(arg, line, len);
+}
+
+static void metrics_write_labeled(metrics_out_cb cb, void* arg, const char* name, const char* label,
+                                  const char* value, uint32_t v) {
+  char line[128];
+  int len = snprintf(line, sizeof(line), "%s{%s=\"%s\"} %u\n", name, label, value, (unsigned)v);
+  if (len > (int)sizeof(line) - 1) len = sizeof(line) - 1;
+  cb(arg, line, len);
+}
+
+// Écrit les séries _bucket (cumulées), _sum et _count d'un histogramme, avec l'étiquette
+// label="value"
+static void metrics_write_histogram(metrics_out_cb cb, void* arg, const char* name, const char* label,
+                                    const char* value, const latency_histogram_t* h) {
+  char line[192];
+  char le[16];
+  uint32_t cumulative = 0;
+  for (int b = 0; b <= METRICS_BUCKETS; b++) {
+    cumulative += h->buckets[b].load(std::memory_order_relaxed);
+    if (b < METRICS_BUCKETS) {
+      metrics_format_seconds(le, sizeof(le), metrics_bucket_us[b]);
+    } else {
+      snprintf(le, sizeof(le), "+Inf");
+    }
+    int len = snprintf(line, sizeof(line), "%s_bucket{%s=\"%s\",le=\"%s\"} %u\n",
+                       name, label, value, le, (unsigned)cumulative);
+    if (len > (int)sizeof(line) - 1) len = sizeof(line) - 1;
+    cb(arg, line, len);
+  }
+
+  char sum[32];
+  metrics_format_seconds(sum, sizeof(sum), h->sum_us.load(std::memory_order_relaxed));
+  int len = snprintf(line, sizeof(line), "%s_sum{%s=\"%s\"} %s\n%s_count{%s=\"%s\"} %u\n",
+                     name, label, value, sum, name, label, value,
+                     (unsigned)h->count.load(std::memory_order_relaxed));
+  if (len > (int)sizeof(line) - 1) len = sizeof(line) - 1;
+  cb(arg, line, len);
+}
+
+#endif // __METRICS_H__
@@ -0,0 +1,123 @@
+// Correction de perspective / rotation par tables de remappage précalculées.
+// L'homographie de calibration envoie un point de l'image redressée vers l'image caméra.
+// Pour chaque pixel des vignettes 28x28, la position source est calculée une seule fois
+// (en flottant) et rangée dans un mot de 32 bits : décalage du pixel haut-gauche dans
+// l'image + fractions x/y sur REMAP_FRAC_BITS bits. Chaque image n'utilise ensuite que
+// des entiers (interpolation bilinéaire).
+// Aucune dépendance Arduino : ce fichier compile aussi sur PC.
+
+#ifndef __PERSPECTIVE_H__
+#define __PERSPECTIVE_H__
+
+#include <stdint.h>
+#include "digit_locator.h"
+
+#define REMAP_SIZE        28 // côté des vignettes produites (entrée du modèle)
+#define REMAP_FRAC_BITS   5  // fractions en 1/32 de pixel
+#define REMAP_FRAC_ONE    (1 << REMAP_FRAC_BITS)
+#define REMAP_FRAC_MASK   (REMAP_FRAC_ONE - 1)
+#define REMAP_OFFSET_SHIFT (2 * REMAP_FRAC_BITS) // 22 bits de décalage : jusqu'à 4 Mpixels
+
+typedef struct {
+  float m[9]; // ligne par ligne, m[8] normalisé à 1
+} homography_t;
+
+typedef struct {
+  uint32_t entries[NUM_DIGITS][REMAP_SIZE * REMAP_SIZE];
+  int width, height; // dimensions de l'image pour lesquelles la table a été construite
+  bool valid;
+} remap_table_t;
+
+static const homography_t HOMOGRAPHY_IDENTITY = { { 1, 0, 0, 0, 1, 0, 0, 0, 1 } };
+
+static void homography_apply(const homography_t* h, float x, float y, float* ox, float* oy) {
+  float w = h->m[6] * x + h->m[7] * y + h->m[8];
+  if (w == 0) w = 1e-6f;
+  *ox = (h->m[0] * x + h->m[1] * y + h->m[2]) / w;
+  *oy = (h->m[3] * x + h->m[4] * y + h->m[5]) / w;
+}
+
+// Inverse par la comatrice ; renvoie false si l'homographie est dégénérée
+static bool homography_invert(const homography_t* h, homography_t* inv) {
+  const float* a = h->m;
+  float c0 = a[4] * a[8] - a[5] * a[7];
+  float c1 = a[5] * a[6] - a[3] * a[8];
+  float c2 = a[3] * a[7] - a[4] * a[6];
+  float det = a[0] * c0 + a[1] * c1 + a[2] * c2;
+  if (det > -1e-9f && det < 1e-9f) return false;
+
+  float r[9] = {
+    c0, a[2] * a[7] - a[1] * a[8], a[1] * a[5] - a[2] * a[4],
+    c1, a[0] * a[8] - a[2] * a[6], a[2] * a[3] - a[0] * a[5],
+    c2, a[1] * a[6] - a[0] * a[7], a[0] * a[4] - a[1] * a[3],
+  };
+  float norm = r[8] != 0 ? r[8] : det;
+  for (int i = 0; i < 9; i++) inv->m[i] = r[i] / norm;
+  return true;
+}
+
+// Rectangle de l'image redressée qui couvre une boîte trouvée dans l'image caméra
+static digit_box_t rectify_box(const homography_t* inv, const digit_box_t* box) {
+  float xs[4] = { (float)box->x, (float)(box->x + box->w), (float)box->x, (float)(box->x + box->w) };
+  float ys[4] = { (float)box->y, (float)box->y, (float)(box->y + box->h), (float)(box->y + box->h) };
+  float x0 = 1e9f, y0 = 1e9f, x1 = -1e9f, y1 = -1e9f;
+  for (int i = 0; i < 4; i++) {
+    float x, y;
+    homography_apply(inv, xs[i], ys[i], &x, &y);
+    if (x < x0) x0 = x;
+    if (x > x1) x1 = x;
+    if (y < y0) y0 = y;
+    if (y > y1) y1 = y;
+  }
+  digit_box_t r = { (int16_t)x0, (int16_t)y0, (int16_t)(x1 - x0 + 0.5f), (int16_t)(y1 - y0 + 0.5f) };
+  return r;
+}
+
+// Précalcule, pour chaque pixel de chaque vignette, sa position dans l'image caméra.
+// `boxes` est dans l'image redressée ; les positions hors image sont ramenées au bord.
+static void remap_build(remap_table_t* table, const homography_t* h, const digit_box_t* boxes,
+                        int width, int height) {
+  for (int d = 0; d < NUM_DIGITS; d++) {
+    const digit_box_t* box = &boxes[d];
+    uint32_t* e = table->entries[d];
+    for (int y = 0; y < REMAP_SIZE; y++) {
+      float v = box->y + (y + 0.5f) * box->h / REMAP_SIZE - 0.5f;
+      for (int x = 0; x < REMAP_SIZE; x++) {
+        float u = box->x + (x + 0.5f) * box->w / REMAP_SIZE - 0.5f;
+        float sx, sy;
+        homography_apply(h, u, v, &sx, &sy);
+
+        int32_t fx = (int32_t)(sx * REMAP_FRAC_ONE + 0.5f);
+        int32_t fy = (int32_t)(sy * REMAP_FRAC_ONE + 0.5f);
+        if (fx < 0) fx = 0;
+        if (fy < 0) fy = 0;
+        if (fx > (width - 2) * REMAP_FRAC_ONE) fx = (width - 2) * REMAP_FRAC_ONE;
+        if (fy > (height - 2) * REMAP_FRAC_ONE) fy = (height - 2) * REMAP_FRAC_ONE;
+
+        uint32_t offset = (uint32_t)(fy >> REMAP_FRAC_BITS) * width + (fx >> REMAP_FRAC_BITS);
+        e[y * REMAP_SIZE + x] = (offset << REMAP_OFFSET_SHIFT) |
+                                ((fy & REMAP_FRAC_MASK) << REMAP_FRAC_BITS) | (fx & REMAP_FRAC_MASK);
+      }
+    }
+  }
+  table->width = width;
+  table->height = height;
+  table->valid = true;
+}
+
+// Produit la vignette REMAP_SIZE x REMAP_SIZE du chiffre `digit` par interpolation bilinéaire entière
+static void remap_apply(const remap_table_t* table, int digit, const uint8_t* frame, uint8_t* out) {
+  const uint32_t* e = table->entries[digit];
+  const int stride = table->width;
+  for (int i = 0; i < REMAP_SIZE * REMAP_SIZE; i++) {
+    uint32_t entry = e[i];
+    const uint8_t* p = frame + (entry >> REMAP_OFFSET_SHIFT);
+    uint32_t fx = entry & REMAP_FRAC_MASK;
+    uint32_t fy = (entry >> REMAP_FRAC_BITS) & REMAP_FRAC_MASK;
+    uint32_t top = p[0] * (REMAP_FRAC_ONE - fx) + p[1] * fx;
+    uint32_t bottom = p[stride] * (REMAP_FRAC_ONE - fx) + p[stride + 1] * fx;
+    out[i] = (top * (REMAP_FRAC_ONE - fy) + bottom * fy + (1 << (2 * REMAP_FRAC_BITS - 1))) >> (2 * REMAP_FRAC_BITS);
+  }
+}
+
+#endif // __PERSPECTIVE_H__
@@ -0,0 +1,38 @@
+// Réservoir d'au plus 32 cases de taille fixe, sans malloc ni verrou : un bit par case occupée,
+// réservé par compare_exchange et rendu par fetch_and. Prendre et rendre peuvent se faire depuis
+// des tâches différentes (handler HTTP et étage inférence pour les demandes de /capture).
+// Aucune dépendance Arduino : ce fichier compile aussi sur PC.
+
+#ifndef __SLOT_POOL_H__
+#define __SLOT_POOL_H__
+
+#include <stdint.h>
+#include <atomic>
+
+typedef struct {
+  std::atomic<uint32_t> used;  // un bit par case
+  uint32_t all;                // bits de toutes les cases
+} slot_pool_t;
+
+static void slot_pool_init(slot_pool_t* pool, int count) {
+  pool->all = count >= 32 ? 0xFFFFFFFFu : (1u << count) - 1;
+  pool->used.store(0);
+}
+
+// Indice d'une case libre, désormais occupée ; -1 si toutes le sont
+static int slot_pool_take(slot_pool_t* pool) {
+  uint32_t used = pool->used.load();
+  while ((used & pool->all) != pool->all) {
+    int i = __builtin_ctz(~used);
+    if (pool->used.compare_exchange_weak(used, used | (1u << i))) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void slot_pool_give(slot_pool_t* pool, int i) {
+  pool->used.fetch_and(~(1u << i));
+}
+
+#endif // __SLOT_POOL_H__
@@ -0,0 +1,77 @@
+// File circulaire à un producteur et un consommateur, sans verrou : passe les images et
+// les résultats d'une tâche à l'autre sans mutex FreeRTOS (donc sans inversion de priorité
+// avec la tâche Wi-Fi). Les éléments sont copiés dans des cases de taille fixe.
+//  - head n'est écrit que par le producteur, tail que par le consommateur ; les deux compteurs
+//    tournent librement (la case est l'indice masqué), la file est pleine quand head - tail == capacité
+//  - publication par store-release, lecture de l'autre compteur par load-acquire
+//  - chaque compteur est sur sa propre ligne de cache, avec la copie locale de l'autre compteur,
+//    pour que producteur et consommateur ne se disputent pas la même ligne
+// Le blocage quand la file est vide ou pleine est laissé à l'appelant (notifications de tâche).
+// Aucune dépendance Arduino : ce fichier compile aussi sur PC.
+
+#ifndef __SPSC_RING_H__
+#define __SPSC_RING_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#if defined(__XTENSA__)
+#define SPSC_CACHE_LINE 32
+#else
+#define SPSC_CACHE_LINE 64
+#endif
+
+typedef struct {
+  alignas(SPSC_CACHE_LINE) std::atomic<uint32_t> head; // prochain élément à écrire (producteur)
+  uint32_t cached_tail;                                // dernier tail lu par le producteur
+  alignas(SPSC_CACHE_LINE) std::atomic<uint32_t> tail; // prochain élément à lire (consommateur)
+  uint32_t cached_head;                                // dernier head lu par le consommateur
+  alignas(SPSC_CACHE_LINE) uint8_t* slots;
+  uint32_t mask;
+  uint32_t slot_size;
+} spsc_ring_t;
+
+// `storage` doit faire capacity * slot_size octets ; capacity est une puissance de 2
+static bool spsc_init(spsc_ring_t* r, void* storage, uint32_t capacity, uint32_t slot_size) {
+  if (!storage || capacity == 0 || (capacity & (capacity - 1))) return false;
+  r->head.store(0, std::memory_order_relaxed);
+  r->tail.store(0, std::memory_order_relaxed);
+  r->cached_head = 0;
+  r->cached_tail = 0;
+  r->slots = (uint8_t*)storage;
+  r->mask = capacity - 1;
+  r->slot_size = slot_size;
+  return true;
+}
+
+// Producteur seulement : false si la file est pleine
+static inline bool spsc_push(spsc_ring_t* r, const void* item) {
+  uint32_t head = r->head.load(std::memory_order_relaxed);
+  if (head - r->cached_tail > r->mask) {
+    r->cached_tail = r->tail.load(std::memory_order_acquire);
+    if (head - r->cached_tail > r->mask) return false;
+  }
+  memcpy(r->slots + (size_t)(head & r->mask) * r->slot_size, item, r->slot_size);
+  r->head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+// Consommateur seulement : false si la file est vide
+static inline bool spsc_pop(spsc_ring_t* r, void* item) {
+  uint32_t tail = r->tail.load(std::memory_order_relaxed);
+  if (tail == r->cached_head) {
+    r->cached_head = r->head.load(std::memory_order_acquire);
+    if (tail == r->cached_head) return false;
+  }
+  memcpy(item, r->slots + (size_t)(tail & r->mask) * r->slot_size, r->slot_size);
+  r->tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+// Nombre d'éléments en attente (approché si appelé par un tiers)
+static inline uint32_t spsc_size(const spsc_ring_t* r) {
+  return r->head.load(std::memory_order_acquire) - r->tail.load(std::memory_order_acquire);
+}
+
+#endif // __SPSC_RING_H__
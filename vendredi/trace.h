@@ -0,0 +1,156 @@
+// Enregistreur de traces début/fin dans un anneau, exporté au format JSON « trace event » de
+// Chrome (chrome://tracing, ui.perfetto.dev) pour voir l'entrelacement capture / inférence / envoi.
+// Chaque événement garde le compteur de cycles du cœur (CCOUNT sur l'ESP32, steady_clock en ns
+// sur PC) et l'horloge µs commune aux deux cœurs :
+//  - les durées entre événements rapprochés d'un même cœur sont calculées en cycles (précises
+//    à quelques ns, CCOUNT reboucle toutes les ~18 s à 240 MHz) ;
+//  - l'horloge µs recale chaque cœur après une pause et aligne les deux cœurs entre eux.
+// L'écriture est sans verrou (un fetch_add réserve la case) ; l'export suspend l'enregistrement.
+// Aucune dépendance Arduino : ce fichier compile aussi sur PC.
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <atomic>
+#if !defined(__XTENSA__)
+#include <chrono>
+#endif
+
+#define TRACE_BEGIN 'B'
+#define TRACE_END   'E'
+#define TRACE_MAX_THREADS 16
+#define TRACE_RESYNC_US   1000000 // au-delà, l'écart entre deux événements d'un cœur est pris sur l'horloge µs
+
+typedef struct {
+  uint32_t cycles;
+  uint32_t us;     // 32 bits de poids faible de l'horloge µs
+  uint32_t tid;    // identifiant de la tâche
+  uint8_t name;    // indice dans la table des noms de l'appelant
+  uint8_t phase;   // TRACE_BEGIN ou TRACE_END
+  uint8_t core;
+  uint8_t unused;
+} trace_event_t;
+
+typedef struct {
+  trace_event_t* events;          // anneau alloué par l'appelant
+  uint32_t capacity;
+  uint32_t cycles_per_us;         // fréquence du CPU en MHz (1000 sur PC : ns)
+  int64_t (*now_us)(void);        // horloge µs commune aux cœurs (esp_timer_get_time)
+  std::atomic<uint32_t> head;     // nombre total d'événements réservés
+  std::atomic<bool> enabled;
+} trace_t;
+
+// Reçoit le JSON produit, morceau par morceau (même forme que metrics_out_cb)
+typedef void (*trace_out_cb)(void* arg, const char* text, size_t len);
+
+static inline uint32_t trace_cycles() {
+#if defined(__XTENSA__)
+  uint32_t ccount;
+  __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+  return ccount;
+#else
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static void trace_init(trace_t* t, trace_event_t* events, uint32_t capacity, uint32_t cycles_per_us,
+                       int64_t (*now_us)(void)) {
+  t->events = events;
+  t->capacity = capacity;
+  t->cycles_per_us = cycles_per_us;
+  t->now_us = now_us;
+  t->head.store(0);
+  t->enabled.store(events != NULL && capacity > 0);
+}
+
+static inline void trace_record(trace_t* t, uint8_t name, uint8_t phase, uint32_t tid, uint8_t core) {
+  if (!t->enabled.load(std::memory_order_relaxed)) return;
+  uint32_t i = t->head.fetch_add(1, std::memory_order_relaxed) % t->capacity;
+  trace_event_t* e = &t->events[i];
+  e->cycles = trace_cycles();
+  e->us = (uint32_t)t->now_us();
+  e->tid = tid;
+  e->name = name;
+  e->phase = phase;
+  e->core = core;
+}
+
+static void trace_clear(trace_t* t) {
+  t->head.store(0);
+}
+
+static void trace_write(trace_out_cb cb, void* arg, const char* text, int len, size_t size) {
+  if (len > (int)size - 1) len = size - 1;
+  if (len > 0) cb(arg, text, len);
+}
+
+// Écrit l'anneau, du plus ancien au plus récent événement. `name_of` donne le nom d'un indice
+// d'événement, `thread_name` celui d'une tâche (peut être NULL).
+static void trace_write_json(trace_t* t, trace_out_cb cb, void* arg, const char* (*name_of)(uint8_t),
+                             const char* (*thread_name)(uint32_t tid)) {
+  bool was_enabled = t->enabled.exchange(false);
+  uint32_t head = t->head.load();
+  uint32_t count = head < t->capacity ? head : t->capacity;
+
+  char line[192];
+  int len = snprintf(line, sizeof(line), "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  trace_write(cb, arg, line, len, sizeof(line));
+
+  // Par cœur : dernier événement vu et son horodatage en ns
+  bool seen[2] = { false, false };
+  uint32_t last_cycles[2] = { 0, 0 }, last_us[2] = { 0, 0 };
+  uint64_t last_ns[2] = { 0, 0 };
+  uint32_t threads[TRACE_MAX_THREADS][2]; // tid, cœur
+  int thread_count = 0;
+
+  for (uint32_t n = 0; n < count; n++) {
+    const trace_event_t* e = &t->events[(head - count + n) % t->capacity];
+    int c = e->core & 1;
+    uint32_t elapsed_us = e->us - last_us[c];
+    uint64_t ns;
+    if (seen[c] && elapsed_us < TRACE_RESYNC_US) {
+      ns = last_ns[c] + (uint64_t)(uint32_t)(e->cycles - last_cycles[c]) * 1000 / t->cycles_per_us;
+    } else {
+      ns = (uint64_t)e->us * 1000;
+    }
+    seen[c] = true;
+    last_cycles[c] = e->cycles;
+    last_us[c] = e->us;
+    last_ns[c] = ns;
+
+    int k = 0;
+    while (k < thread_count && (threads[k][0] != e->tid || threads[k][1] != e->core)) k++;
+    if (k == thread_count && thread_count < TRACE_MAX_THREADS) {
+      threads[thread_count][0] = e->tid;
+      threads[thread_count][1] = e->core;
+      thread_count++;
+    }
+
+    len = snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":%u,\"tid\":%u}",
+                   n ? ",\n" : "", name_of(e->name), e->phase, (unsigned long long)(ns / 1000),
+                   (unsigned)(ns % 1000), (unsigned)e->core, (unsigned)e->tid);
+    trace_write(cb, arg, line, len, sizeof(line));
+  }
+
+  // Métadonnées : un « processus » par cœur, le nom de chaque tâche
+  for (int c = 0; c < 2; c++) {
+    len = snprintf(line, sizeof(line), "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"core %d\"}}",
+                   count || c ? ",\n" : "", c, c);
+    trace_write(cb, arg, line, len, sizeof(line));
+  }
+  for (int k = 0; k < thread_count && thread_name; k++) {
+    len = snprintf(line, sizeof(line), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                   (unsigned)threads[k][1], (unsigned)threads[k][0], thread_name(threads[k][0]));
+    trace_write(cb, arg, line, len, sizeof(line));
+  }
+  len = snprintf(line, sizeof(line), "\n]}\n");
+  trace_write(cb, arg, line, len, sizeof(line));
+
+  t->enabled.store(was_enabled);
+}
+
+#endif // __TRACE_H__
@@ -23,8 +23,89 @@
 #include "soc/soc.h"
 #include "soc/rtc_cntl_reg.h"
 #include "esp_http_server.h"
+#include "esp_idf_version.h"
+#include "esp_heap_caps.h"
+#include "esp_attr.h"
+#include "esp_sleep.h"
+#include "driver/gpio.h"
 #include <HTTPClient.h>
+#include "ping/ping_sock.h"
+#include "metrics.h"
+#include "trace.h"
+#include "spsc_ring.h"
+#include "arena.h"
+#include "memory_stats.h"
+#include "capture_schedule.h"
+#include "log_ring.h"
+#include "log_formats.h"
+
+// Trace début/fin des étapes et des couches, exportée par /trace
+#define TRACE_EVENTS 1024 // 16 octets par événement, une dizaine de lectures
+trace_t tracer;
+
+void trace_here(uint8_t name, uint8_t phase) {
+    trace_record(&tracer, name, phase, (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle(), xPortGetCoreID());
+}
+
+// Journal différé (voir log_ring.h) : LOG_DEFERRED(LOG_xxx, jusqu'à 4 entiers) coûte quelques µs
+// quel que soit le débit série ; logTask affiche les messages, /log renvoie l'anneau brut
+#define LOG_SLOTS 256 // 28 octets par message, puissance de 2
+log_ring_t logRing;
+
+void log_here(uint16_t id, int32_t a0, int32_t a1, int32_t a2, int32_t a3) {
+    log_write(&logRing, id, (uint32_t)esp_timer_get_time(), xPortGetCoreID(), a0, a1, a2, a3);
+}
+
+#define LOG_PICK(id, a0, a1, a2, a3, ...) log_here(id, a0, a1, a2, a3)
+#define LOG_DEFERRED(...) LOG_PICK(__VA_ARGS__, 0, 0, 0, 0)
+
+// Instants de fin des étapes du démarrage, en µs depuis le reset (0 : pas encore atteinte),
+// exposés sur /metrics pour mesurer le gain du démarrage rapide
+typedef enum {
+    BOOT_CAMERA,          // esp_camera_init() terminé
+    BOOT_BUFFERS,         // arènes, tampons et disposition des chiffres prêts
+    BOOT_SERVER,          // lectures planifiées et serveurs HTTP démarrés
+    BOOT_WIFI_ASSOCIATED, // associé au point d'accès
+    BOOT_WIFI_IP,         // adresse IP obtenue (ou reprise du cache)
+    BOOT_FIRST_READING,   // première lecture publiée
+    BOOT_STAGE_COUNT
+} boot_stage_t;
+
+const char* const bootStageNames[BOOT_STAGE_COUNT] = {
+    "camera", "buffers", "server", "wifi_associated", "wifi_ip", "first_reading",
+};
+uint32_t bootStageUs[BOOT_STAGE_COUNT]; // écrits une seule fois, depuis plusieurs tâches
+bool wifiFastConnect = false;           // association en cours ou réussie avec le cache RTC
+SemaphoreHandle_t wifiReady = NULL;     // donné à l'obtention de l'adresse IP
+
+void boot_stage(boot_stage_t stage) {
+    if (!bootStageUs[stage]) {
+        bootStageUs[stage] = (uint32_t)esp_timer_get_time();
+    }
+}
+
+// Durée de chaque couche de cnn(), relevée par les points d'accroche du modèle
+enum {
+    LAYER_conv2d_2, LAYER_max_pooling2d_2, LAYER_conv2d_3, LAYER_max_pooling2d_3,
+    LAYER_flatten_1, LAYER_dense_2, LAYER_dense_3, LAYER_COUNT
+};
+const char* const layerNames[LAYER_COUNT] = {
+    "conv2d_2", "max_pooling2d_2", "conv2d_3", "max_pooling2d_3", "flatten_1", "dense_2", "dense_3",
+};
+latency_histogram_t layerLatency[LAYER_COUNT];
+#define MODEL_LAYER_BEGIN(layer) trace_here(LAYER_##layer, TRACE_BEGIN); int64_t layer##_start = esp_timer_get_time()
+#define MODEL_LAYER_END(layer) histogram_observe(&layerLatency[LAYER_##layer], esp_timer_get_time() - layer##_start); \
+                               trace_here(LAYER_##layer, TRACE_END)
+
 #include "gsc_model_fixed.h"
+#include "exposure.h"
+#include "digit_locator.h"
+#include "perspective.h"
+#include "frame_quality.h"
+#include "gray_codec.h"
+#include "meter_decoder.h"
+#include "wheel_position.h"
+#include "slot_pool.h"
 
 
 //Replace with your network credentials
@@ -128,11 +209,10 @@ typedef struct {
 
 esp_timer_handle_t photo_timer;
 
-unsigned long lastCaptureTime = 0;
-
 static const char* _STREAM_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=" PART_BOUNDARY;
 static const char* _STREAM_BOUNDARY = "\r\n--" PART_BOUNDARY "\r\n";
-static const char* _STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n";
+// Pas de Content-Length : le JPEG part au fil de la compression, la limite suffit au client
+static const char* _STREAM_PART = "Content-Type: image/jpeg\r\n\r\n";
 
 httpd_handle_t stream_httpd = NULL;
 httpd_handle_t camera_httpd = NULL;
@@ -142,18 +222,204 @@ httpd_handle_t camera_httpd = NULL;
 #define ROI_X_MAX 640 
 #define ROI_Y_MAX 480 
 
-#define LED_CHANNEL     0
+#define LED_CHANNEL     2 // le canal 0 (timer 0) est déjà utilisé par la caméra pour XCLK
 #define LED_RESOLUTION  8 // Nombre de bits pour la résolution de PWM (de 0 à 255)
 
-// Fonction pour initialiser le flash avec PWM
+// Fonction pour initialiser le flash avec PWM (API LEDC d'arduino-esp32 3.x : canal imposé,
+// pour ne pas prendre celui de XCLK)
 void setupFlashPWM() {
-    ledcAttachPin(LED_GPIO_NUM, LED_CHANNEL);
-    ledcSetup(LED_CHANNEL, 5000, LED_RESOLUTION); // Fréquence de PWM: 5000 Hz
+    ledcAttachChannel(LED_GPIO_NUM, 5000, LED_RESOLUTION, LED_CHANNEL); // Fréquence de PWM: 5000 Hz
 }
 
+// Dernier changement effectif du flash (horloge esp_timer) : une image commencée avant a été
+// prise avec l'ancien réglage. Modifiés pipelineMutex pris, comme le flash lui-même.
+int flashDuty = -1;
+int64_t flashSetUs = 0;
+
 // Fonction pour régler l'intensité du flash
 void setFlashIntensity(int intensity) {
-    ledcWrite(LED_CHANNEL, intensity);
+    if (intensity != flashDuty) {
+        ledcWrite(LED_GPIO_NUM, intensity);
+        flashDuty = intensity;
+        flashSetUs = esp_timer_get_time();
+    }
+}
+
+// Durée des étapes d'une lecture, exposée sur /metrics
+typedef enum {
+    STAGE_FLASH_SETTLE, // réglage du flash -> première image prise avec ce réglage
+    STAGE_FB_GET,       // chaque esp_camera_fb_get()
+    STAGE_CROP,
+    STAGE_PREPROCESS,   // remappage et binarisation d'un chiffre
+    STAGE_SEND,         // encodage et envoi de la réponse de /capture (entrelacés)
+    STAGE_READING,      // lecture complète, de la capture à la publication (histogramme seulement)
+    STAGE_STREAM_FRAME, // capture, encodage et envoi d'une image de /stream
+    STAGE_CAPTURE,      // étage capture : image exposée, localisation, contrôle qualité
+    STAGE_INFERENCE,    // étage inférence : recadrage, entrées du modèle, cnn(), publication
+    STAGE_COUNT
+} pipeline_stage_t;
+
+const char* const stageNames[STAGE_COUNT] = {
+    "flash_settle", "fb_get", "crop", "preprocess", "send", "reading", "stream_frame", "capture", "inference",
+};
+latency_histogram_t stageLatency[STAGE_COUNT];
+
+// Dans la trace, les étapes suivent les couches du modèle
+#define TRACE_STAGE(stage) (LAYER_COUNT + (stage))
+
+const char* trace_name(uint8_t id) {
+    if (id < LAYER_COUNT) {
+        return layerNames[id];
+    }
+    if (id < TRACE_STAGE(STAGE_COUNT)) {
+        return stageNames[id - LAYER_COUNT];
+    }
+    return "unknown";
+}
+
+// Relevés mémoire avant et après les grandes étapes seulement : le plus grand bloc libre se
+// calcule en parcourant le tas, trop cher pour chaque fb_get ou chaque chiffre
+bool stage_watches_memory(pipeline_stage_t stage) {
+    switch (stage) {
+        case STAGE_CROP:
+        case STAGE_SEND:
+        case STAGE_STREAM_FRAME:
+        case STAGE_CAPTURE:
+        case STAGE_INFERENCE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+memory_watch_t stageMemory[STAGE_COUNT];
+memory_sample_t stageMemoryBefore[STAGE_COUNT];
+
+void take_memory_sample(memory_sample_t* sample) {
+    sample->free_bytes = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    sample->largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    sample->stack_free = uxTaskGetStackHighWaterMark(NULL); // en octets sur l'ESP32
+}
+
+// Début et fin d'une étape : histogramme de /metrics, relevés mémoire et trace de /trace
+int64_t stage_begin(pipeline_stage_t stage) {
+    trace_here(TRACE_STAGE(stage), TRACE_BEGIN);
+    if (stage_watches_memory(stage)) {
+        take_memory_sample(&stageMemoryBefore[stage]);
+    }
+    return esp_timer_get_time();
+}
+
+void stage_end(pipeline_stage_t stage, int64_t start) {
+    histogram_observe(&stageLatency[stage], esp_timer_get_time() - start);
+    if (stage_watches_memory(stage)) {
+        memory_sample_t after;
+        take_memory_sample(&after);
+        memory_watch_stage(&stageMemory[stage], &stageMemoryBefore[stage], &after);
+    }
+    trace_here(TRACE_STAGE(stage), TRACE_END);
+}
+
+// Tampons du pipeline réservés au démarrage dans deux arènes (voir arena.h) : DRAM interne pour
+// ce qui est relu à chaque image, PSRAM pour les grandes images. Les tableaux statiques (tables
+// de remappage, entrées et activations de cnn()) sont déjà placés en DRAM par l'éditeur de liens.
+#define CROP_MAX_PIXELS  (640 * 480) // FRAMESIZE_VGA : la bande ne peut pas dépasser l'image
+#define DRAM_ARENA_SIZE  (sizeof(locator_work_t) + 1024)
+#define PSRAM_ARENA_SIZE (CROP_MAX_PIXELS + TRACE_EVENTS * sizeof(trace_event_t) + LOG_SLOTS * sizeof(log_slot_t) + 1024)
+
+arena_t dramArena;
+arena_t psramArena;
+
+typedef enum {
+    PLACE_DRAM,
+    PLACE_PSRAM,
+} placement_t;
+
+void setupArenas() {
+    arena_init(&dramArena, "dram", heap_caps_malloc(DRAM_ARENA_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+               DRAM_ARENA_SIZE);
+    arena_init(&psramArena, "psram", psramFound() ? heap_caps_malloc(PSRAM_ARENA_SIZE, MALLOC_CAP_SPIRAM) : NULL,
+               PSRAM_ARENA_SIZE);
+    if (!dramArena.base || (psramFound() && !psramArena.base)) {
+        Serial.println("Failed to reserve pipeline arenas");
+    }
+}
+
+// Prend le tampon dans l'arène demandée, sinon dans l'autre (sans PSRAM, tout vient de la DRAM).
+// À n'appeler que depuis setup().
+void* pipeline_alloc(size_t size, placement_t where) {
+    arena_t* first = where == PLACE_DRAM ? &dramArena : &psramArena;
+    arena_t* second = where == PLACE_DRAM ? &psramArena : &dramArena;
+    void* p = arena_alloc(first, size, ARENA_DEFAULT_ALIGN);
+    if (!p) {
+        p = arena_alloc(second, size, ARENA_DEFAULT_ALIGN);
+    }
+    if (!p) {
+        Serial.printf("Arena full: %u bytes\n", (unsigned)size);
+    }
+    return p;
+}
+
+void setupTracer() {
+    // En PSRAM si elle est là : la trace n'est relue que par /trace
+    trace_event_t* events = (trace_event_t*)pipeline_alloc(TRACE_EVENTS * sizeof(trace_event_t), PLACE_PSRAM);
+    trace_init(&tracer, events, events ? TRACE_EVENTS : 0, ESP.getCpuFreqMHz(), esp_timer_get_time);
+}
+
+// Affichage des messages du journal sur Serial, loin du chemin de capture
+#define LOG_DRAIN_INTERVAL_MS 100
+
+#define LOG_FORMAT_TEXT(id, format) format,
+const char* const logFormats[LOG_FORMAT_COUNT] = { LOG_FORMATS(LOG_FORMAT_TEXT) };
+#undef LOG_FORMAT_TEXT
+
+log_cursor_t logDrain; // lu par /metrics pour les messages perdus
+
+void print_log_record(const log_record_t* r) {
+    char line[160];
+    int len = snprintf(line, sizeof(line), "[%u.%03u] ", (unsigned)(r->us / 1000000), (unsigned)(r->us / 1000 % 1000));
+    if (r->id < LOG_FORMAT_COUNT) {
+        snprintf(line + len, sizeof(line) - len, logFormats[r->id],
+                 (int)r->args[0], (int)r->args[1], (int)r->args[2], (int)r->args[3]);
+    } else {
+        snprintf(line + len, sizeof(line) - len, "unknown message %u", (unsigned)r->id);
+    }
+    Serial.println(line);
+}
+
+void log_task(void* arg) {
+    uint32_t reportedLost = 0;
+    for (;;) {
+        log_record_t record;
+        while (log_read(&logRing, &logDrain, &record)) {
+            print_log_record(&record);
+        }
+        if (logDrain.lost != reportedLost) {
+            Serial.printf("Log: %u messages lost\n", (unsigned)(logDrain.lost - reportedLost));
+            reportedLost = logDrain.lost;
+        }
+        vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_INTERVAL_MS));
+    }
+}
+
+void setupLog() {
+    // En PSRAM si elle est là, comme la trace
+    log_slot_t* slots = (log_slot_t*)pipeline_alloc(LOG_SLOTS * sizeof(log_slot_t), PLACE_PSRAM);
+    if (!log_init(&logRing, slots, LOG_SLOTS)) {
+        return; // LOG_DEFERRED ne fait alors plus rien
+    }
+    logDrain = log_oldest(&logRing);
+    xTaskCreatePinnedToCore(log_task, "log", 3072, NULL, 1, NULL, 0);
+}
+
+// Tampon de recadrage réservé une seule fois : prendre un second tampon du driver avec
+// esp_camera_fb_get() bloquait la file d'images de la caméra pendant tout l'envoi
+camera_fb_t cropped;
+size_t croppedCapacity = 0;
+
+void setupCropBuffer() {
+    cropped.buf = (uint8_t*)pipeline_alloc(CROP_MAX_PIXELS, PLACE_PSRAM);
+    croppedCapacity = cropped.buf ? CROP_MAX_PIXELS : 0;
 }
 
 camera_fb_t* crop_image(camera_fb_t* src_fb, int x_min, int y_min, int x_max, int y_max) {
@@ -167,20 +433,17 @@ camera_fb_t* crop_image(camera_fb_t* src_fb, int x_min, int y_min, int x_max, in
   if (y_max > src_height) y_max = src_height;
 
   int crop_width = x_max - x_min;
-  Serial.print("crop width:");
-
-  Serial.print(crop_width);
   int crop_height = y_max - y_min;
-  Serial.print("crop height:");
-
-  Serial.print(crop_height);
+  LOG_DEFERRED(LOG_CROP_SIZE, crop_width, crop_height);
 
   uint8_t* src_data = src_fb->buf;
-  camera_fb_t* cropped_fb = esp_camera_fb_get();
-  if (!cropped_fb) {
-    Serial.println("Failed to allocate memory for cropped image");
+
+  if (croppedCapacity < (size_t)(crop_width * crop_height)) {
+    LOG_DEFERRED(LOG_CROP_TOO_LARGE, crop_width * crop_height);
     return NULL;
   }
+  camera_fb_t* cropped_fb = &cropped;
+  cropped_fb->timestamp = src_fb->timestamp;
   cropped_fb->format = PIXFORMAT_GRAYSCALE;
   cropped_fb->width = crop_width;
   cropped_fb->height = crop_height;
@@ -199,107 +462,1154 @@ camera_fb_t* crop_image(camera_fb_t* src_fb, int x_min, int y_min, int x_max, in
 }
 
 
+#define DIGIT_THRESHOLD 100                        // seuil de binarisation utilisé à l'entraînement (CNN_MODEL.ipynb)
+#define DIGIT_INPUT_ONE (1 << MODEL_INPUT_SCALE_FACTOR) // 1.0 en virgule fixe Q9.7
+#define DIGIT_SCORE_SCALE_FACTOR 7                      // sortie de dense_3, elle aussi en Q9.7
+
+// Homographie de calibration (image redressée -> image caméra), affichée par DigitBoxCallibrage.py.
+// L'identité désactive la correction de perspective.
+const homography_t calibrationHomography = { { 1, 0, 0, 0, 1, 0, 0, 0, 1 } };
+homography_t calibrationInverse;
+
+// Tables de remappage des vignettes, reconstruites seulement quand la disposition change
+remap_table_t remapTable;
+uint32_t remapLayoutRuns = 0; // runs de la disposition des tables (0 : disposition fixe)
+
+locator_work_t* locatorWork = NULL;
+digit_layout_t digitLayout;
+digit_layout_t fixedLayout; // ROI_* découpée en NUM_DIGITS boîtes égales, si la localisation échoue
+int64_t lastLocateUs = 0;   // durée de la dernière mise à jour de la disposition
+
+void setupDigitLayout() {
+    locatorWork = (locator_work_t*)pipeline_alloc(sizeof(locator_work_t), PLACE_DRAM);
+    if (!locatorWork) {
+        Serial.println("Failed to allocate digit locator memory");
+    }
+
+    memset(&digitLayout, 0, sizeof(digitLayout));
+    memset(&fixedLayout, 0, sizeof(fixedLayout));
+    fixedLayout.strip = { ROI_X_MIN, ROI_Y_MIN, ROI_X_MAX - ROI_X_MIN, ROI_Y_MAX - ROI_Y_MIN };
+    int digitWidth = (ROI_X_MAX - ROI_X_MIN) / NUM_DIGITS;
+    for (int d = 0; d < NUM_DIGITS; d++) {
+        fixedLayout.digits[d] = { (int16_t)(ROI_X_MIN + d * digitWidth), ROI_Y_MIN, (int16_t)digitWidth, ROI_Y_MAX - ROI_Y_MIN };
+    }
+    fixedLayout.valid = true;
+
+    if (!homography_invert(&calibrationHomography, &calibrationInverse)) {
+        Serial.println("Calibration homography is singular, perspective correction disabled");
+        calibrationInverse = HOMOGRAPHY_IDENTITY;
+    }
+    remapTable.valid = false;
+}
+
+// Disposition des chiffres pour cette image : celle du cache, relocalisée si la bande a bougé
+const digit_layout_t* current_digit_layout(const camera_fb_t* fb) {
+    if (!locatorWork) {
+        return &fixedLayout;
+    }
+    int64_t start = esp_timer_get_time();
+    bool found = update_digit_layout(fb->buf, fb->width, fb->height, locatorWork, &digitLayout);
+    lastLocateUs = esp_timer_get_time() - start;
+    return found ? &digitLayout : &fixedLayout;
+}
+
+// Reconstruit les tables de remappage si la disposition des chiffres a changé.
+// Les boîtes trouvées dans l'image caméra sont ramenées dans l'image redressée, puis
+// chaque pixel des vignettes est renvoyé dans l'image caméra par l'homographie.
+void update_remap_table(const camera_fb_t* fb, const digit_layout_t* layout) {
+    if (remapTable.valid && remapLayoutRuns == layout->runs &&
+        remapTable.width == (int)fb->width && remapTable.height == (int)fb->height) {
+        return;
+    }
+
+    digit_box_t boxes[NUM_DIGITS];
+    for (int d = 0; d < NUM_DIGITS; d++) {
+        boxes[d] = rectify_box(&calibrationInverse, &layout->digits[d]);
+    }
+    remap_build(&remapTable, &calibrationHomography, boxes, fb->width, fb->height);
+    remapLayoutRuns = layout->runs;
+}
+
+// Vignette 28x28 redressée d'un chiffre, binarisée comme les images d'entraînement
+void digit_to_input(const camera_fb_t* fb, int digit, input_t input) {
+    uint8_t patch[REMAP_SIZE * REMAP_SIZE];
+    remap_apply(&remapTable, digit, fb->buf, patch);
+
+    for (int y = 0; y < MODEL_INPUT_DIM_0; y++) {
+        for (int x = 0; x < MODEL_INPUT_DIM_1; x++) {
+            input[y][x][0] = patch[y * REMAP_SIZE + x] > DIGIT_THRESHOLD ? DIGIT_INPUT_ONE : 0;
+        }
+    }
+}
+
+// Entrées du modèle de la dernière lecture, 1 bit par pixel (elles sont binaires) : 98 octets par chiffre
+#define PACKED_INPUT_SIZE ((MODEL_INPUT_DIM_0 * MODEL_INPUT_DIM_1 + 7) / 8)
+uint8_t lastDigitInputs[NUM_DIGITS][PACKED_INPUT_SIZE];
+
+void pack_input_bits(const input_t input, uint8_t* packed) {
+    memset(packed, 0, PACKED_INPUT_SIZE);
+    for (int i = 0; i < MODEL_INPUT_DIM_0 * MODEL_INPUT_DIM_1; i++) {
+        if (input[i / MODEL_INPUT_DIM_1][i % MODEL_INPUT_DIM_1][0]) {
+            packed[i >> 3] |= 0x80 >> (i & 7);
+        }
+    }
+}
+
+static_assert(MODEL_OUTPUT_SAMPLES == METER_CLASSES, "one model output per digit class");
+
+// Lance le modèle et renvoie le score de chaque classe (sorties de dense_3, avant softmax)
+void classify_digit(const input_t input, int16_t* scores) {
+    output_t output;
+    cnn(input, output);
+    memcpy(scores, output, sizeof(output_t));
+}
+
+// Assemblage des chiffres en index (voir meter_decoder.h)
+const meter_rules_t meterRules = {
+    .min_margin = 2 << DIGIT_SCORE_SCALE_FACTOR,    // 2.0 d'écart entre les deux meilleures classes
+    .reject_margin = 2 << DIGIT_SCORE_SCALE_FACTOR,
+    .max_delta = 500,                               // au-delà, longue coupure : relecture et rejets
+    .full_every = 20,
+    .rebase_after = 3,
+};
+
+meter_state_t meterState;
+meter_scores_t digitScores;          // étage inférence seulement
+unsigned long digitInferences = 0;   // cnn() lancés
+unsigned long skippedInferences = 0; // chiffres repris de l'index précédent sans cnn()
+unsigned long implausibleReadings = 0;
+
+
+const int maxQualityAttempts = 3;
+
+// Seuils du contrôle qualité, mesurés sur la bande des chiffres
+const quality_limits_t qualityLimits = {
+    .min_sharpness = 40,
+    .max_saturated_permille = 50,
+    .min_mean = 40,
+    .max_mean = 220,
+};
+
+unsigned long qualityRetries = 0;
+unsigned long rejectedFrames = 0;
+
+quality_verdict_t check_frame_quality(const camera_fb_t* fb, const digit_layout_t* layout, frame_quality_t* quality) {
+    const digit_box_t* strip = &layout->strip;
+    measure_frame_quality(fb->buf, fb->width, fb->height,
+                          strip->x, strip->y, strip->x + strip->w, strip->y + strip->h, quality);
+    return judge_frame_quality(quality, &qualityLimits);
+}
+
 const int defaultFlashIntensity = 20;
+const int maxExposureAttempts = 4;
+
+// Réglage du flash conservé d'une capture à l'autre : une fois convergé, une seule image suffit
+exposure_ctrl_t exposure = {
+    .target_low = 90,
+    .target_high = 160,
+    .max_saturated_permille = 20,
+    .duty = defaultFlashIntensity,
+    .min_duty = 1,
+    .max_duty = (1 << LED_RESOLUTION) - 1,
+};
+
+const int64_t freshFrameTimeoutUs = 500000;
+
+// Compteurs des images jetées parce qu'elles avaient commencé avant le dernier réglage du flash
+unsigned long staleFramesDropped = 0;
+unsigned long freshFrameTimeouts = 0;
+
+int64_t frame_timestamp_us(const camera_fb_t* fb) {
+  return (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+}
 
+// Renvoie la première image dont l'acquisition a commencé après `since_us` (horloge esp_timer,
+// la même que celle du driver pour fb->timestamp). Les images plus anciennes, encore dans les
+// tampons du driver, ont été prises avec l'ancien réglage du flash et sont rendues aussitôt.
+camera_fb_t* get_fresh_frame(int64_t since_us, int64_t timeout_us) {
+  int64_t deadline = esp_timer_get_time() + timeout_us;
 
-static esp_err_t capture_handler(httpd_req_t *req){
-  setFlashIntensity(defaultFlashIntensity);
-  delay(50);
-    // Toggle the LED to indicate photo capture
+  for (;;) {
+    int64_t start = stage_begin(STAGE_FB_GET);
+    camera_fb_t* fb = esp_camera_fb_get();
+    stage_end(STAGE_FB_GET, start);
+    if (!fb) {
+      return NULL;
+    }
+    if (frame_timestamp_us(fb) >= since_us) {
+      return fb;
+    }
 
-    camera_fb_t * fb = NULL;
-    esp_err_t res = ESP_OK;
+    esp_camera_fb_return(fb);
+    staleFramesDropped++;
+    if (esp_timer_get_time() >= deadline) {
+      freshFrameTimeouts++;
+      return NULL;
+    }
+  }
+}
+
+// Capture une image bien exposée : l'histogramme de la ROI règle le flash pour l'image suivante,
+// et on s'arrête dès que l'exposition est dans la cible au lieu d'attendre un délai fixe
+camera_fb_t* capture_exposed_frame() {
+  setFlashIntensity(exposure.duty);
+  int64_t flashChangedUs = stage_begin(STAGE_FLASH_SETTLE);
 
-    // Capture a photo
-    fb = esp_camera_fb_get();
+  for (int attempt = 1; ; attempt++) {
+    camera_fb_t* fb = get_fresh_frame(flashChangedUs, freshFrameTimeoutUs);
+    stage_end(STAGE_FLASH_SETTLE, flashChangedUs);
     if (!fb) {
-        Serial.println("Camera capture failed");
-        httpd_resp_send_500(req);
-        
-        // Turn off the LED if capture failed
-        digitalWrite(LED_GPIO_NUM, LOW);
-        
-        return ESP_FAIL;
+      return NULL;
     }
 
+    roi_histogram_t hist;
+    const digit_box_t* roi = digitLayout.valid ? &digitLayout.strip : &fixedLayout.strip;
+    roi_histogram(fb->buf, fb->width, fb->height, roi->x, roi->y, roi->x + roi->w, roi->y + roi->h, &hist);
+    if (exposure_update(&exposure, &hist) != EXPOSURE_ADJUSTED || attempt >= maxExposureAttempts) {
+      return fb;
+    }
+
+    esp_camera_fb_return(fb);
+    setFlashIntensity(exposure.duty);
+    flashChangedUs = stage_begin(STAGE_FLASH_SETTLE);
+  }
+}
+
+
+// Résultat d'une lecture, publié dans latestReading pour les handlers HTTP
+typedef struct {
+    bool valid;                // false tant qu'aucune lecture n'a abouti
+    uint32_t sequence;         // incrémenté à chaque publication
+    int64_t timestamp_us;      // début de l'image lue (horloge esp_timer)
+    int64_t clock_us;          // même instant sur sleep_clock_us(), qui survit au sommeil profond
+    quality_verdict_t verdict;
+    frame_quality_t quality;
+    meter_verdict_t meter;     // assemblage des chiffres par meter_decoder.h
+    uint32_t value;            // index du compteur, le dernier accepté si !valid
+    int8_t digits[NUM_DIGITS]; // classe brute prédite, du poids fort aux unités (-1 si non lu) ;
+                               // les chiffres de l'index sont ceux de value
+    int16_t scores[NUM_DIGITS];
+    int16_t fraction;          // part de la roue des unités entre deux chiffres, en millièmes (wheel_position.h)
+    uint8_t fraction_confidence; // 0..100, 0 si la part n'a pas pu être estimée
+} meter_reading_t;
+
+meter_reading_t latestReading;
+portMUX_TYPE readingMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Sérialise l'accès à la caméra, au flash et à la disposition des chiffres (étage capture et
+// /stream). Les tampons du recadrage, des tables de remappage et de cnn() n'appartiennent
+// qu'à l'étage inférence.
+SemaphoreHandle_t pipelineMutex = NULL;
+
+void publish_reading(meter_reading_t* reading) {
+    portENTER_CRITICAL(&readingMux);
+    reading->sequence = latestReading.sequence + 1;
+    latestReading = *reading;
+    portEXIT_CRITICAL(&readingMux);
+}
+
+void get_latest_reading(meter_reading_t* reading) {
+    portENTER_CRITICAL(&readingMux);
+    *reading = latestReading;
+    portEXIT_CRITICAL(&readingMux);
+}
+
+// Intervalle des lectures planifiées, adapté au débit d'eau (voir capture_schedule.h) : de 5 s
+// pendant un fort débit à 10 min sur un compteur à l'arrêt
+const uint32_t initialCaptureIntervalMs = 100000;
+
+capture_schedule_t captureSchedule = {
+    .min_interval_ms = 5000,
+    .max_interval_ms = 600000,
+    .target_step = 2,
+    .burst_count = 3,
+};
+
+// Horloge de l'ordonnanceur et de l'âge des lectures : gettimeofday continue pendant le sommeil
+// profond, pas esp_timer
+int64_t sleep_clock_us() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// Chiffre des unités d'une lecture pour l'ordonnanceur, -1 si elle n'est pas exploitable
+int schedule_units(esp_err_t err, const meter_reading_t* reading) {
+    return err == ESP_OK && reading->valid ? (int)(reading->value % 10) : -1;
+}
+
+// Image prise par l'étage capture, passée à l'étage inférence qui la rend au driver
+typedef struct {
+    struct capture_job* job;   // demande à servir, NULL pour une lecture planifiée
+    camera_fb_t* fb;           // NULL : demande rattachée à la dernière lecture, ou capture échouée
+    bool failed;
+    digit_layout_t layout;     // copie : l'étage capture peut relocaliser pendant l'inférence
+    quality_verdict_t verdict;
+    frame_quality_t quality;
+    int64_t started_us;
+} frame_job_t;
+
+// Étage capture, pipelineMutex pris : image bien exposée, disposition des chiffres et contrôle
+// qualité, en recommençant si l'image est floue, éblouie ou mal exposée
+esp_err_t capture_reading_frame(frame_job_t* frame) {
+    camera_fb_t * fb = NULL;
+    frame->started_us = esp_timer_get_time();
+
+    // Capture a photo, again while it is blurred, glared or badly exposed
+    const digit_layout_t* layout = NULL;
+    quality_verdict_t verdict = QUALITY_OK;
+    for (int attempt = 1; ; attempt++) {
+        fb = capture_exposed_frame();
+        if (!fb) {
+            LOG_DEFERRED(LOG_CAPTURE_FAILED);
+            
+            // Turn off the LED if capture failed
+            setFlashIntensity(0);
+            
+            return ESP_FAIL;
+        }
+
+        // Localise the digit strip (cached, re-run only when it drifted)
+        layout = current_digit_layout(fb);
+
+        verdict = check_frame_quality(fb, layout, &frame->quality);
+        if (verdict == QUALITY_OK || attempt >= maxQualityAttempts) {
+            break;
+        }
+        esp_camera_fb_return(fb);
+        qualityRetries++;
+    }
+    setFlashIntensity(0);
+
+    frame->fb = fb;
+    frame->layout = *layout;
+    frame->verdict = verdict;
+    LOG_DEFERRED(LOG_CAPTURE_STATS, staleFramesDropped, lastLocateUs, digitLayout.runs);
+    return ESP_OK;
+}
+
+// Entrées du modèle de l'image en cours d'inférence (étage inférence seulement)
+input_t digitInputs[NUM_DIGITS];
+
+// Étage inférence : recadrage de la bande, entrées du modèle de chaque chiffre puis classification,
+// et publication. L'image est rendue au driver dès les entrées calculées, avant les inférences,
+// pour que l'étage capture puisse déjà remplir la suivante. La bande recadrée est rendue dans
+// `cropped_out` et reste valable jusqu'à la prochaine lecture.
+esp_err_t infer_reading(frame_job_t* frame, meter_reading_t* reading, camera_fb_t** cropped_out) {
+    camera_fb_t* fb = frame->fb;
+    const digit_layout_t* layout = &frame->layout;
+    quality_verdict_t verdict = frame->verdict;
+    reading->timestamp_us = frame_timestamp_us(fb);
+    reading->clock_us = sleep_clock_us() - (esp_timer_get_time() - reading->timestamp_us);
+    reading->verdict = verdict;
+    reading->quality = frame->quality;
+
     // Crop the captured image
-    camera_fb_t* cropped_fb = crop_image(fb, ROI_X_MIN, ROI_Y_MIN, ROI_X_MAX, ROI_Y_MAX);
-    if (!cropped_fb) {
-        Serial.println("Failed to crop image");
-        httpd_resp_send_500(req);
+    const digit_box_t* strip = &layout->strip;
+    int64_t crop_start = stage_begin(STAGE_CROP);
+    *cropped_out = crop_image(fb, strip->x, strip->y, strip->x + strip->w, strip->y + strip->h);
+    stage_end(STAGE_CROP, crop_start);
+    if (!*cropped_out) {
+        LOG_DEFERRED(LOG_CROP_FAILED);
         esp_camera_fb_return(fb);
-        
-        // Turn off the LED if cropping failed
-        digitalWrite(LED_GPIO_NUM, LOW);
-        
         return ESP_FAIL;
     }
-    // Inside capture_handler function after cropping the image
 
-    // Call the CNN model with the cropped image
-    // Inside capture_handler function after cropping the image
+    // Classify each digit, from the most significant one to the units.
+    // A frame that still fails the quality check is not worth an inference.
+    if (verdict != QUALITY_OK) {
+        esp_camera_fb_return(fb);
+        rejectedFrames++;
+        LOG_DEFERRED(LOG_FRAME_REJECTED, verdict, reading->quality.mean, reading->quality.sharpness,
+                     reading->quality.saturated_permille);
+        for (int d = 0; d < NUM_DIGITS; d++) {
+            reading->digits[d] = -1;
+            reading->scores[d] = 0;
+        }
+        memset(lastDigitInputs, 0, sizeof(lastDigitInputs));
+        reading->fraction = 0;
+        reading->fraction_confidence = 0;
+        reading->meter = METER_REJECTED;
+        reading->value = meterState.value;
+    } else {
+        update_remap_table(fb, layout);
+        for (int d = 0; d < NUM_DIGITS; d++) {
+            int64_t preprocess_start = stage_begin(STAGE_PREPROCESS);
+            digit_to_input(fb, d, digitInputs[d]);
+            stage_end(STAGE_PREPROCESS, preprocess_start);
+            pack_input_bits(digitInputs[d], lastDigitInputs[d]);
+        }
+        esp_camera_fb_return(fb);
 
-// Convert the cropped image buffer to the correct input type for the CNN model
-    input_t input;
-    for (int y = 0; y < 28; y++) {
-        for (int x = 0; x < 28; x++) {
-            // Convert uint8_t pixel values to int16_t
-            input[y][x][0] = (int16_t)cropped_fb->buf[y * 28 + x];
+        // Les unités d'abord, puis seulement les chiffres qui ont pu changer depuis l'index précédent
+        int first = NUM_DIGITS - 1;
+        classify_digit(digitInputs[first], digitScores[first]);
+        for (;;) {
+            int needed = meter_digits_needed(&meterRules, &meterState, digitScores, first);
+            if (needed >= first) {
+                break;
+            }
+            for (int d = needed; d < first; d++) {
+                classify_digit(digitInputs[d], digitScores[d]);
+            }
+            first = needed;
+        }
+        digitInferences += NUM_DIGITS - first;
+        skippedInferences += first;
+
+        // Sorties du modèle ; les chiffres qu'il n'a pas relus sont marqués non lus (-1, score 0),
+        // leur valeur n'est que dans l'index
+        for (int d = 0; d < NUM_DIGITS; d++) {
+            if (d < first) {
+                reading->digits[d] = -1;
+                reading->scores[d] = 0;
+            } else {
+                int16_t margin;
+                reading->digits[d] = meter_best(digitScores[d], &margin);
+                reading->scores[d] = digitScores[d][reading->digits[d]];
+                LOG_DEFERRED(LOG_DIGIT, d, reading->digits[d], reading->scores[d]);
+            }
+        }
+        reading->meter = meter_decode(&meterRules, &meterState, digitScores, first, &reading->value);
+        if (reading->meter == METER_REJECTED) {
+            implausibleReadings++;
         }
+        LOG_DEFERRED(LOG_METER, reading->value, reading->meter, NUM_DIGITS - first);
+
+        // Roue des unités souvent prise entre deux chiffres : part fractionnaire d'après les deux
+        // meilleurs scores et le profil vertical de l'entrée, rapportée à l'index retenu
+        wheel_position_t wheel;
+        estimate_wheel_position(digitScores[NUM_DIGITS - 1], lastDigitInputs[NUM_DIGITS - 1],
+                                MODEL_INPUT_DIM_1, MODEL_INPUT_DIM_0, &wheel);
+        int offset = 0;
+        bool aligned = reading->meter != METER_REJECTED && wheel_offset(&wheel, reading->value % 10, &offset);
+        reading->fraction = (int16_t)offset;
+        reading->fraction_confidence = aligned ? wheel.confidence : 0;
+        LOG_DEFERRED(LOG_WHEEL, wheel.position, wheel.confidence, wheel.shift_rows, wheel.rolling);
     }
 
-    // Call the CNN model with the cropped and converted image
-    output_t output;
-    cnn(input, output);
+    // Index valable si l'image est bonne et que les chiffres collent aux règles du compteur ;
+    // sinon value garde le dernier index accepté
+    reading->valid = verdict == QUALITY_OK && reading->meter != METER_REJECTED;
+    publish_reading(reading);
+    histogram_observe(&stageLatency[STAGE_READING], esp_timer_get_time() - frame->started_us);
+    return ESP_OK;
+}
 
-// Interpret the output of the model...
 
+const int captureJpegQuality = 90;
 
-    // Interpret the output of the model
-    // For example, if your output is a classification result, find the class with the highest probability
-    int predicted_class = 0;
-    float max_probability = 0.0;
+// Appelé par l'encodeur à chaque morceau de JPEG produit : le morceau part aussitôt,
+// sans tampon de sortie à la taille de l'image
+static size_t jpg_encode_stream(void * arg, size_t index, const void* data, size_t len){
+    jpg_chunking_t *j = (jpg_chunking_t *)arg;
+    if (!index) {
+        j->len = 0;
+    }
+    if (httpd_resp_send_chunk(j->req, (const char *)data, len) != ESP_OK) {
+        return 0;
+    }
+    j->len += len;
+    return len;
+}
 
-    // Trouver la classe avec la probabilité la plus élevée
-    for (int i = 0; i < MODEL_OUTPUT_SAMPLES; i++) {
-        if (output[i] > max_probability) {
-            max_probability = output[i];
-            predicted_class = i;
-        }
+// Formats d'image de /capture?format=... (JPEG par défaut)
+typedef enum {
+    CAPTURE_FORMAT_JPEG,
+    CAPTURE_FORMAT_QOG,  // sans perte, voir gray_codec.h
+    CAPTURE_FORMAT_BITS, // 1 bit par pixel après binarisation
+} capture_format_t;
+
+// Lit la valeur d'un paramètre de la requête ; renvoie false s'il est absent
+bool get_query_value(httpd_req_t *req, const char* key, char* value, size_t len) {
+    char query[64];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK) {
+        return false;
     }
+    return httpd_query_key_value(query, key, value, len) == ESP_OK;
+}
 
-    // Afficher la classe prédite et sa probabilité
-    Serial.print("Predicted class: ");
-    Serial.println(predicted_class);
-    Serial.print("Probability: ");
-    Serial.println(max_probability);
+capture_format_t get_capture_format(httpd_req_t *req) {
+    char format[8];
+    if (!get_query_value(req, "format", format, sizeof(format))) {
+        return CAPTURE_FORMAT_JPEG;
+    }
+    if (!strcmp(format, "qog")) {
+        return CAPTURE_FORMAT_QOG;
+    }
+    if (!strcmp(format, "bits")) {
+        return CAPTURE_FORMAT_BITS;
+    }
+    return CAPTURE_FORMAT_JPEG;
+}
 
-    // Further actions based on the predicted class can be added here
+// Réponse de /capture?digits=only : exactement ce que cnn() a vu, pour archiver les entrées.
+// "DIG1", nombre de chiffres, hauteur, largeur, drapeaux (bit 0 : lecture valide),
+// timestamp_us (int64), séquence (uint32), puis pour chaque chiffre classe (int8, -1 si cnn() ne
+// l'a pas lu) et score (int16, Q9.7), puis les entrées binaires de chaque chiffre, 1 bit par pixel, bit de poids
+// fort en premier. Entiers en petit-boutiste ; captureDecode.py sait le relire.
+size_t pack_digit_inputs(const meter_reading_t* reading, uint8_t* out) {
+    size_t len = 0;
+    memcpy(out, "DIG1", 4);
+    len += 4;
+    out[len++] = NUM_DIGITS;
+    out[len++] = MODEL_INPUT_DIM_0;
+    out[len++] = MODEL_INPUT_DIM_1;
+    out[len++] = reading->valid ? 1 : 0;
+    for (int i = 0; i < 8; i++) {
+        out[len++] = (uint64_t)reading->timestamp_us >> (8 * i);
+    }
+    for (int i = 0; i < 4; i++) {
+        out[len++] = reading->sequence >> (8 * i);
+    }
+    for (int d = 0; d < NUM_DIGITS; d++) {
+        out[len++] = (uint8_t)reading->digits[d];
+        out[len++] = (uint16_t)reading->scores[d] & 0xff;
+        out[len++] = (uint16_t)reading->scores[d] >> 8;
+    }
+    memcpy(out + len, lastDigitInputs, sizeof(lastDigitInputs));
+    return len + sizeof(lastDigitInputs);
+}
 
+// Envoie la réponse de /capture pour la dernière lecture. À appeler depuis l'étage inférence :
+// la bande recadrée et les entrées du modèle sont réutilisées par la lecture suivante.
+esp_err_t send_capture(httpd_req_t *req, const meter_reading_t* reading, camera_fb_t* cropped_fb,
+                       capture_format_t format, bool digits_only) {
+    esp_err_t res = ESP_OK;
+    int64_t send_start = stage_begin(STAGE_SEND);
+    if (digits_only) {
+        uint8_t packed[20 + NUM_DIGITS * 3 + sizeof(lastDigitInputs)];
+        size_t len = pack_digit_inputs(reading, packed);
+
+        httpd_resp_set_type(req, "application/octet-stream");
+        httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=digits.bin");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        httpd_resp_set_hdr(req, "X-Frame-Quality", quality_verdict_name(reading->verdict));
+        res = httpd_resp_send(req, (const char *)packed, len);
+        stage_end(STAGE_SEND, send_start);
+        return res;
+    }
 
     // Set the content type and headers
-    httpd_resp_set_type(req, "image/jpeg");
-    httpd_resp_set_hdr(req, "Content-Disposition", "inline; filename=capture.jpg");
+    if (format == CAPTURE_FORMAT_JPEG) {
+        httpd_resp_set_type(req, "image/jpeg");
+        httpd_resp_set_hdr(req, "Content-Disposition", "inline; filename=capture.jpg");
+    } else {
+        httpd_resp_set_type(req, "application/octet-stream");
+        httpd_resp_set_hdr(req, "Content-Disposition", format == CAPTURE_FORMAT_QOG ?
+                           "attachment; filename=capture.qog" : "attachment; filename=capture.bits");
+    }
     httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "X-Frame-Quality", quality_verdict_name(reading->verdict));
+
+    // Encode the cropped image and send it chunk by chunk as it is produced
+    // (the cropped buffer is reused by the next reading)
+    jpg_chunking_t jchunk = {req, 0};
+    bool encoded;
+    switch (format) {
+        case CAPTURE_FORMAT_QOG:
+            encoded = qog_encode_cb(cropped_fb->buf, cropped_fb->width, cropped_fb->height,
+                                    jpg_encode_stream, &jchunk);
+            break;
+        case CAPTURE_FORMAT_BITS:
+            encoded = bitpack_encode_cb(cropped_fb->buf, cropped_fb->width, cropped_fb->height,
+                                        DIGIT_THRESHOLD, jpg_encode_stream, &jchunk);
+            break;
+        default:
+            encoded = frame2jpg_cb(cropped_fb, captureJpegQuality, jpg_encode_stream, &jchunk);
+            break;
+    }
+    res = encoded ? ESP_OK : ESP_FAIL;
+    if (res == ESP_OK) {
+        res = httpd_resp_send_chunk(req, NULL, 0);
+    } else {
+        LOG_DEFERRED(LOG_ENCODING_FAILED);
+    }
+    stage_end(STAGE_SEND, send_start);
 
-    // Send the cropped image data
-    res = httpd_resp_send(req, (const char *)cropped_fb->buf, cropped_fb->len);
+    return res;
+}
 
-    // Free up the memory used for the photo capture and cropped image
-    esp_camera_fb_return(fb);
-    esp_camera_fb_return(cropped_fb);
-    delay(5);
+// /capture détache sa requête (httpd_req_async_handler_begin, IDF 5.1) pour que le serveur du
+// port 81 continue de servir /reading, /metrics, /trace et /log pendant la capture
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 1, 0)
+#error "arduino-esp32 3.x (ESP-IDF 5.1 ou plus) requis"
+#endif
 
+// Demande de lecture, traitée par l'étage capture puis par l'étage inférence qui répond
+typedef struct capture_job {
+    httpd_req_t *req;        // NULL pour une lecture planifiée
+    capture_format_t format;
+    bool digits_only;
+    int64_t queued_us;
+    bool retry;              // relancée après l'échec de la lecture partagée : capture propre
+} capture_job_t;
+
+// Les demandes détachées survivent au handler : elles sont prises dans un réservoir fixe
+// (file de demandes, étage capture, file d'images, étage inférence) plutôt qu'avec malloc
+#define CAPTURE_JOB_POOL 16
+capture_job_t captureJobPool[CAPTURE_JOB_POOL];
+slot_pool_t captureJobs;
+
+capture_job_t* capture_job_alloc() {
+    int i = slot_pool_take(&captureJobs);
+    return i < 0 ? NULL : &captureJobPool[i];
+}
 
-    // Turn off the LED after photo capture process is complete
+void capture_job_free(capture_job_t* job) {
+    slot_pool_give(&captureJobs, job - captureJobPool);
+}
+
+#define CAPTURE_QUEUE_LENGTH 8
+
+// Une demande arrivée pendant une lecture, ou moins de captureFreshnessUs après la prise de la
+// dernière image, reçoit cette lecture au lieu d'en relancer une : plusieurs clients qui
+// interrogent /capture ensemble ne coûtent qu'un cycle de flash et quatre inférences
+const int64_t captureFreshnessUs = 1000000;
+
+// Dernière lecture aboutie, avec sa bande recadrée (étage inférence seulement)
+typedef struct {
+    bool valid;
+    meter_reading_t reading;
+    camera_fb_t* cropped_fb;
+} capture_result_t;
+
+capture_result_t lastCapture;
+unsigned long captureRequests = 0;
+unsigned long coalescedCaptures = 0;
+
+// Étage capture seulement
+bool lastFrameCaptured = false;
+int64_t lastFrameUs = 0;
+std::atomic<uint32_t> framesInInference(0); // images passées à l'étage inférence, pas encore publiées
+
+// Une demande se rattache à la lecture en cours d'inférence, ou à la dernière si elle est récente.
+// L'étage inférence traite la file dans l'ordre : cette lecture sera publiée avant d'y arriver.
+bool capture_can_attach(const capture_job_t* job) {
+    return lastFrameCaptured &&
+           (framesInInference.load() > 0 || job->queued_us <= lastFrameUs + captureFreshnessUs);
+}
+
+QueueHandle_t captureQueue = NULL; // de capture_job_t*, NULL pour une lecture planifiée
+
+esp_err_t send_capture_busy(httpd_req_t *req) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_hdr(req, "Retry-After", "1");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_sendstr(req, "Capture queue full");
+}
+
+void finish_capture_job(capture_job_t* job) {
+    httpd_req_async_handler_complete(job->req);
+    capture_job_free(job);
+}
+
+// /capture ne fait que déposer une demande : la capture et l'inférence tournent dans la tâche de lecture
+static esp_err_t capture_handler(httpd_req_t *req){
+    capture_job_t job = { req, get_capture_format(req), false, esp_timer_get_time(), false };
+
+    char digits[8];
+    job.digits_only = get_query_value(req, "digits", digits, sizeof(digits)) && !strcmp(digits, "only");
+
+    // La requête est détachée : le serveur continue de servir /reading, /metrics... pendant la capture
+    capture_job_t* queued = capture_job_alloc();
+    if (!queued) {
+        return send_capture_busy(req);
+    }
+    *queued = job;
+    if (httpd_req_async_handler_begin(req, &queued->req) != ESP_OK) {
+        capture_job_free(queued);
+        return httpd_resp_send_500(req);
+    }
+    if (xQueueSend(captureQueue, &queued, 0) != pdTRUE) {
+        esp_err_t res = send_capture_busy(queued->req);
+        httpd_req_async_handler_complete(queued->req);
+        capture_job_free(queued);
+        return res;
+    }
+    return ESP_OK;
+}
+
+
+// Lecture au format JSON (quelques centaines d'octets) : /reading, et POST en mode sommeil profond
+int format_reading_json(char* json, size_t size, const meter_reading_t* reading) {
+    int len = snprintf(json, size,
+                       "{\"valid\":%s,\"sequence\":%u,\"value\":%u,\"quality\":\"%s\",\"meter\":\"%s\","
+                       "\"timestamp_us\":%lld,\"age_ms\":%lld,\"digits\":[",
+                       reading->valid ? "true" : "false", (unsigned)reading->sequence, (unsigned)reading->value,
+                       quality_verdict_name(reading->verdict), meter_verdict_name(reading->meter),
+                       (long long)reading->timestamp_us,
+                       reading->sequence ? (long long)(sleep_clock_us() - reading->clock_us) / 1000 : -1LL);
+    // "class" : chiffre de l'index décodé, comme "value" ; "read" : classe brute du modèle pour
+    // cette boîte (-1 si cnn() ne l'a pas lue), qui peut différer quand les règles l'ont corrigée
+    for (int d = 0; d < NUM_DIGITS; d++) {
+        len += snprintf(json + len, size - len, "%s{\"class\":%d,\"read\":%d,\"score\":%.2f}",
+                        d ? "," : "", meter_digit(reading->value, d), reading->digits[d],
+                        (float)reading->scores[d] / (1 << DIGIT_SCORE_SCALE_FACTOR));
+    }
+    // Index avec la part de la roue des unités, le compteur rebouclant à 9999
+    double fractional = reading->value + reading->fraction / 1000.0;
+    if (fractional < 0) fractional += meter_range();
+    len += snprintf(json + len, size - len, "],\"fractional_value\":%.3f,\"transition_confidence\":%.2f}",
+                    fractional, reading->fraction_confidence / 100.0);
+    return len;
+}
+
+static esp_err_t reading_handler(httpd_req_t *req){
+    meter_reading_t reading;
+    get_latest_reading(&reading);
+
+    char json[512];
+    int len = format_reading_json(json, sizeof(json), &reading);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_send(req, json, len);
+}
+
+
+// Texte de /metrics regroupé en morceaux de taille raisonnable avant envoi
+typedef struct {
+    httpd_req_t *req;
+    char buf[1024];
+    size_t used;
+    esp_err_t res;
+} metrics_chunk_t;
+
+void metrics_flush(metrics_chunk_t* m) {
+    if (m->used && m->res == ESP_OK) {
+        m->res = httpd_resp_send_chunk(m->req, m->buf, m->used);
+    }
+    m->used = 0;
+}
+
+void metrics_append(void* arg, const char* text, size_t len) {
+    metrics_chunk_t* m = (metrics_chunk_t*)arg;
+    if (m->used + len > sizeof(m->buf)) {
+        metrics_flush(m);
+    }
+    memcpy(m->buf + m->used, text, len);
+    m->used += len;
+}
+
+// Métriques au format texte de Prometheus : histogrammes de latence par étape et par couche
+// du modèle, compteurs du pipeline. Ne prend aucun verrou : lisible pendant une lecture.
+static esp_err_t metrics_handler(httpd_req_t *req){
+    static metrics_chunk_t m; // 1 Ko : hors de la pile de la tâche du serveur, qui est seule à servir
+    m.req = req;
+    m.used = 0;
+    m.res = ESP_OK;
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+
+    metrics_write_family(metrics_append, &m, "watermeter_stage_duration_seconds", "histogram",
+                         "Duration of each stage of a reading.");
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        metrics_write_histogram(metrics_append, &m, "watermeter_stage_duration_seconds", "stage",
+                                stageNames[s], &stageLatency[s]);
+    }
+    metrics_write_family(metrics_append, &m, "watermeter_cnn_layer_duration_seconds", "histogram",
+                         "Duration of each layer of the digit classifier.");
+    for (int l = 0; l < LAYER_COUNT; l++) {
+        metrics_write_histogram(metrics_append, &m, "watermeter_cnn_layer_duration_seconds", "layer",
+                                layerNames[l], &layerLatency[l]);
+    }
+
+    meter_reading_t reading;
+    get_latest_reading(&reading);
+    metrics_write_family(metrics_append, &m, "watermeter_readings_total", "counter", "Readings published.");
+    metrics_write_value(metrics_append, &m, "watermeter_readings_total", reading.sequence);
+    metrics_write_family(metrics_append, &m, "watermeter_rejected_frames_total", "counter",
+                         "Readings whose frame failed the quality check.");
+    metrics_write_value(metrics_append, &m, "watermeter_rejected_frames_total", rejectedFrames);
+    metrics_write_family(metrics_append, &m, "watermeter_quality_retries_total", "counter",
+                         "Frames captured again after a failed quality check.");
+    metrics_write_value(metrics_append, &m, "watermeter_quality_retries_total", qualityRetries);
+    metrics_write_family(metrics_append, &m, "watermeter_stale_frames_dropped_total", "counter",
+                         "Frames dropped because they started before the last flash change.");
+    metrics_write_value(metrics_append, &m, "watermeter_stale_frames_dropped_total", staleFramesDropped);
+    metrics_write_family(metrics_append, &m, "watermeter_fresh_frame_timeouts_total", "counter",
+                         "Captures that gave up waiting for a fresh frame.");
+    metrics_write_value(metrics_append, &m, "watermeter_fresh_frame_timeouts_total", freshFrameTimeouts);
+    metrics_write_family(metrics_append, &m, "watermeter_capture_requests_total", "counter",
+                         "Requests to /capture handled by the reading task.");
+    metrics_write_value(metrics_append, &m, "watermeter_capture_requests_total", captureRequests);
+    metrics_write_family(metrics_append, &m, "watermeter_coalesced_captures_total", "counter",
+                         "Requests to /capture answered with a reading already in flight or still fresh.");
+    metrics_write_value(metrics_append, &m, "watermeter_coalesced_captures_total", coalescedCaptures);
+    metrics_write_family(metrics_append, &m, "watermeter_digit_inferences_total", "counter",
+                         "Digits classified by the model.");
+    metrics_write_value(metrics_append, &m, "watermeter_digit_inferences_total", digitInferences);
+    metrics_write_family(metrics_append, &m, "watermeter_skipped_inferences_total", "counter",
+                         "Digits taken from the previous index without running the model.");
+    metrics_write_value(metrics_append, &m, "watermeter_skipped_inferences_total", skippedInferences);
+    metrics_write_family(metrics_append, &m, "watermeter_implausible_readings_total", "counter",
+                         "Readings rejected by the odometer rules.");
+    metrics_write_value(metrics_append, &m, "watermeter_implausible_readings_total", implausibleReadings);
+    metrics_write_family(metrics_append, &m, "watermeter_layout_runs_total", "counter",
+                         "Full runs of the digit locator.");
+    metrics_write_value(metrics_append, &m, "watermeter_layout_runs_total", digitLayout.runs);
+    metrics_write_family(metrics_append, &m, "watermeter_log_lost_total", "counter",
+                         "Deferred log messages overwritten before being printed.");
+    metrics_write_value(metrics_append, &m, "watermeter_log_lost_total", logDrain.lost);
+    // Marge mémoire : extrêmes relevés autour des grandes étapes, puis état actuel du tas
+    static const struct {
+        const char* name;
+        const char* help;
+    } memoryFamilies[] = {
+        { "watermeter_stage_heap_free_min_bytes", "Lowest free internal heap seen around the stage." },
+        { "watermeter_stage_heap_free_max_bytes", "Highest free internal heap seen around the stage." },
+        { "watermeter_stage_heap_largest_block_min_bytes", "Smallest largest free internal block seen around the stage." },
+        { "watermeter_stage_heap_drop_max_bytes", "Largest drop of free internal heap during one run of the stage." },
+        { "watermeter_stage_stack_free_min_bytes", "Stack high-water mark of the task running the stage." },
+    };
+    for (int f = 0; f < 5; f++) {
+        metrics_write_family(metrics_append, &m, memoryFamilies[f].name, "gauge", memoryFamilies[f].help);
+        for (int st = 0; st < STAGE_COUNT; st++) {
+            const memory_watch_t* w = &stageMemory[st];
+            if (!w->valid) {
+                continue;
+            }
+            uint32_t values[5] = { w->min.free_bytes, w->max.free_bytes, w->min.largest_block,
+                                   (uint32_t)w->max_drop, w->min.stack_free };
+            metrics_write_labeled(metrics_append, &m, memoryFamilies[f].name, "stage", stageNames[st], values[f]);
+        }
+    }
+    metrics_write_family(metrics_append, &m, "watermeter_heap_free_bytes", "gauge", "Free heap.");
+    metrics_write_labeled(metrics_append, &m, "watermeter_heap_free_bytes", "region", "internal",
+                          heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    metrics_write_labeled(metrics_append, &m, "watermeter_heap_free_bytes", "region", "psram",
+                          heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    metrics_write_family(metrics_append, &m, "watermeter_heap_free_min_bytes", "gauge", "Lowest free heap since boot.");
+    metrics_write_labeled(metrics_append, &m, "watermeter_heap_free_min_bytes", "region", "internal",
+                          heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    metrics_write_labeled(metrics_append, &m, "watermeter_heap_free_min_bytes", "region", "psram",
+                          heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+    metrics_write_family(metrics_append, &m, "watermeter_heap_largest_block_bytes", "gauge",
+                         "Largest free block, a drop with steady free heap means fragmentation.");
+    metrics_write_labeled(metrics_append, &m, "watermeter_heap_largest_block_bytes", "region", "internal",
+                          heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    metrics_write_labeled(metrics_append, &m, "watermeter_heap_largest_block_bytes", "region", "psram",
+                          heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
+    metrics_write_family(metrics_append, &m, "watermeter_arena_used_bytes", "gauge", "Bytes reserved in the boot arenas.");
+    metrics_write_labeled(metrics_append, &m, "watermeter_arena_used_bytes", "arena", dramArena.name, dramArena.used);
+    metrics_write_labeled(metrics_append, &m, "watermeter_arena_used_bytes", "arena", psramArena.name, psramArena.used);
+    metrics_write_family(metrics_append, &m, "watermeter_arena_size_bytes", "gauge", "Size of the boot arenas.");
+    metrics_write_labeled(metrics_append, &m, "watermeter_arena_size_bytes", "arena", dramArena.name, dramArena.size);
+    metrics_write_labeled(metrics_append, &m, "watermeter_arena_size_bytes", "arena", psramArena.name, psramArena.size);
+
+    metrics_write_family(metrics_append, &m, "watermeter_boot_stage_microseconds", "gauge",
+                         "Time since reset at which each boot stage completed.");
+    for (int b = 0; b < BOOT_STAGE_COUNT; b++) {
+        if (bootStageUs[b]) {
+            metrics_write_labeled(metrics_append, &m, "watermeter_boot_stage_microseconds", "stage",
+                                  bootStageNames[b], bootStageUs[b]);
+        }
+    }
+    metrics_write_family(metrics_append, &m, "watermeter_wifi_fast_connect", "gauge",
+                         "1 if Wi-Fi reconnected with the cached channel, BSSID and IP.");
+    metrics_write_value(metrics_append, &m, "watermeter_wifi_fast_connect", wifiFastConnect);
+
+    metrics_write_family(metrics_append, &m, "watermeter_capture_interval_milliseconds", "gauge",
+                         "Interval before the next scheduled reading, adapted to the flow.");
+    metrics_write_value(metrics_append, &m, "watermeter_capture_interval_milliseconds", captureSchedule.interval_ms);
+    metrics_write_family(metrics_append, &m, "watermeter_flow_units_per_hour", "gauge",
+                         "Flow estimated from the lowest wheel, in units of that wheel per hour.");
+    metrics_write_value(metrics_append, &m, "watermeter_flow_units_per_hour", captureSchedule.rate_uph);
+
+    metrics_write_family(metrics_append, &m, "watermeter_flash_duty", "gauge", "Current flash PWM duty.");
+    metrics_write_value(metrics_append, &m, "watermeter_flash_duty", exposure.duty);
+
+    metrics_flush(&m);
+    if (m.res != ESP_OK) {
+        return m.res;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+
+const char* trace_thread_name(uint32_t tid) {
+    return pcTaskGetName((TaskHandle_t)(uintptr_t)tid);
+}
+
+// Trace des derniers événements au format JSON de Chrome, à ouvrir dans ui.perfetto.dev ;
+// /trace?clear=1 vide l'anneau après l'envoi, pour isoler la prochaine lecture
+static esp_err_t trace_handler(httpd_req_t *req){
+    static metrics_chunk_t m;
+    m.req = req;
+    m.used = 0;
+    m.res = ESP_OK;
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=trace.json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+
+    trace_write_json(&tracer, metrics_append, &m, trace_name, trace_thread_name);
+    char clear[4];
+    if (get_query_value(req, "clear", clear, sizeof(clear)) && clear[0] == '1') {
+        trace_clear(&tracer);
+    }
+
+    metrics_flush(&m);
+    if (m.res != ESP_OK) {
+        return m.res;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// Messages encore dans l'anneau du journal, bruts (voir log_ring.h), sans les retirer de
+// l'affichage sur Serial : python logDecode.py http://[YourIP]:81/log
+static esp_err_t log_handler(httpd_req_t *req){
+    static metrics_chunk_t m;
+    m.req = req;
+    m.used = 0;
+    m.res = ESP_OK;
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=log.bin");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+
+    log_cursor_t cursor = log_oldest(&logRing);
+    uint8_t header[12] = { 'L', 'O', 'G', '1' };
+    uint16_t record_size = sizeof(log_record_t);
+    uint16_t format_count = LOG_FORMAT_COUNT;
+    uint32_t written = logRing.head.load();
+    memcpy(header + 4, &record_size, 2);
+    memcpy(header + 6, &format_count, 2);
+    memcpy(header + 8, &written, 4);
+    metrics_append(&m, (const char*)header, sizeof(header));
+
+    log_record_t record;
+    while (m.res == ESP_OK && log_read(&logRing, &cursor, &record)) {
+        metrics_append(&m, (const char*)&record, sizeof(record));
+    }
+
+    metrics_flush(&m);
+    if (m.res != ESP_OK) {
+        return m.res;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+
+const int streamFrameIntervalMs = 200; // 5 images/s : assez pour cadrer, sans gêner les lectures
+const int streamJpegQuality = 80;
+
+// Dessine les boîtes des chiffres localisés dans l'image, pour vérifier le cadrage
+void draw_digit_boxes(camera_fb_t* fb, const digit_layout_t* layout) {
+    if (!layout->valid) {
+        return;
+    }
+    for (int d = 0; d < NUM_DIGITS; d++) {
+        const digit_box_t* box = &layout->digits[d];
+        // Boîte ramenée dans l'image ; rien à tracer si elle est vide ou en dehors
+        int x0 = box->x > 0 ? box->x : 0;
+        int y0 = box->y > 0 ? box->y : 0;
+        int x1 = (box->x + box->w < (int)fb->width ? box->x + box->w : (int)fb->width) - 1;
+        int y1 = (box->y + box->h < (int)fb->height ? box->y + box->h : (int)fb->height) - 1;
+        if (x1 < x0 || y1 < y0) {
+            continue;
+        }
+        for (int x = x0; x <= x1; x++) {
+            fb->buf[y0 * fb->width + x] = 255;
+            fb->buf[y1 * fb->width + x] = 255;
+        }
+        for (int y = y0; y <= y1; y++) {
+            fb->buf[y * fb->width + x0] = 255;
+            fb->buf[y * fb->width + x1] = 255;
+        }
+    }
+}
+
+// Flux MJPEG : chaque image est encodée en JPEG et envoyée comme une partie multipart.
+// Le pipeline n'est réservé que le temps de prendre l'image, et le débit est limité à
+// une image toutes les streamFrameIntervalMs pour laisser passer les lectures planifiées.
+static esp_err_t stream_handler(httpd_req_t *req){
+    esp_err_t res = httpd_resp_set_type(req, _STREAM_CONTENT_TYPE);
+    if (res != ESP_OK) {
+        return res;
+    }
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+
+    while (res == ESP_OK) {
+        int64_t frame_start = stage_begin(STAGE_STREAM_FRAME);
+
+        xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+        // Une lecture a pu changer le flash depuis l'image précédente : pas d'image d'avant le réglage
+        setFlashIntensity(exposure.duty);
+        camera_fb_t* fb = get_fresh_frame(flashSetUs, freshFrameTimeoutUs);
+        digit_layout_t overlay = digitLayout;
+        xSemaphoreGive(pipelineMutex);
+        if (!fb) {
+            LOG_DEFERRED(LOG_STREAM_FAILED);
+            stage_end(STAGE_STREAM_FRAME, frame_start);
+            res = ESP_FAIL;
+            break;
+        }
+
+        // Le JPEG est envoyé morceau par morceau, comme pour /capture, sans tampon à la taille de l'image
+        draw_digit_boxes(fb, &overlay);
+        res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
+        if (res == ESP_OK) {
+            res = httpd_resp_send_chunk(req, _STREAM_PART, strlen(_STREAM_PART));
+        }
+        if (res == ESP_OK) {
+            jpg_chunking_t jchunk = {req, 0};
+            if (!frame2jpg_cb(fb, streamJpegQuality, jpg_encode_stream, &jchunk)) {
+                LOG_DEFERRED(LOG_STREAM_JPEG);
+                res = ESP_FAIL;
+            }
+        }
+        esp_camera_fb_return(fb);
+        stage_end(STAGE_STREAM_FRAME, frame_start);
+
+        int64_t elapsed_ms = (esp_timer_get_time() - frame_start) / 1000;
+        if (elapsed_ms < streamFrameIntervalMs) {
+            vTaskDelay(pdMS_TO_TICKS(streamFrameIntervalMs - elapsed_ms));
+        }
+    }
+
+    // Turn off the LED when the client leaves
+    xSemaphoreTake(pipelineMutex, portMAX_DELAY);
     setFlashIntensity(0);
+    xSemaphoreGive(pipelineMutex);
 
     return res;
 }
 
 
+// Deux étages reliés par une file bornée : l'étage capture (cœur 0, surtout de l'attente sur le
+// driver et le flash) prend l'image N+1 pendant que l'étage inférence (cœur 1, loin du Wi-Fi)
+// traite l'image N. La file d'une seule image limite à trois les tampons tenus par le pipeline.
+// C'est une file SPSC sans verrou ; chaque étage réveille l'autre par notification de tâche.
+#define FRAME_QUEUE_LENGTH 1 // puissance de 2
+frame_job_t frameSlots[FRAME_QUEUE_LENGTH];
+spsc_ring_t frameRing;
+TaskHandle_t captureTask = NULL;
+TaskHandle_t inferenceTask = NULL;
+
+// Les notifications restent comptées si l'autre tâche ne dort pas encore : aucun réveil perdu,
+// au pire un tour de boucle pour rien
+void push_frame(const frame_job_t* frame) {
+    while (!spsc_push(&frameRing, frame)) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    xTaskNotifyGive(inferenceTask);
+}
+
+void pop_frame(frame_job_t* frame) {
+    while (!spsc_pop(&frameRing, frame)) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    xTaskNotifyGive(captureTask);
+}
 
+// Le timer ne fait que déposer une lecture planifiée : le pipeline ne tourne pas dans la tâche
+// esp_timer. C'est un timer à un coup, réarmé par l'étage inférence une fois la lecture faite avec
+// l'intervalle suivant ; si la file est pleine, la lecture est refusée et retentée plus tard.
+void photo_timer_callback(void* arg) {
+    capture_job_t* job = NULL;
+    if (xQueueSend(captureQueue, &job, 0) != pdTRUE) {
+        esp_timer_start_once(photo_timer, (uint64_t)captureSchedule.min_interval_ms * 1000);
+    }
+}
 
+// Étage capture : lectures planifiées et demandes de /capture, une à la fois, dans l'ordre
+void capture_task(void* arg) {
+    for (;;) {
+        capture_job_t* job = NULL;
+        xQueueReceive(captureQueue, &job, portMAX_DELAY);
+
+        frame_job_t frame;
+        memset(&frame, 0, sizeof(frame));
+        frame.job = job;
+        if (!job || job->retry || !capture_can_attach(job)) {
+            int64_t start = stage_begin(STAGE_CAPTURE);
+            xSemaphoreTake(pipelineMutex, portMAX_DELAY);
+            frame.failed = capture_reading_frame(&frame) != ESP_OK;
+            xSemaphoreGive(pipelineMutex);
+            stage_end(STAGE_CAPTURE, start);
+
+            if (!frame.failed) {
+                lastFrameCaptured = true;
+                lastFrameUs = frame.started_us;
+                framesInInference++;
+            }
+        }
+        push_frame(&frame);
+    }
+}
+
+// Étage inférence : lecture de l'image reçue (ou réutilisation de la dernière), puis réponse
+void inference_task(void* arg) {
+    for (;;) {
+        frame_job_t frame;
+        pop_frame(&frame);
+
+        int64_t start = stage_begin(STAGE_INFERENCE);
+        esp_err_t err = ESP_OK;
+        if (frame.fb) {
+            lastCapture.valid = false;
+            err = infer_reading(&frame, &lastCapture.reading, &lastCapture.cropped_fb);
+            if (err == ESP_OK) {
+                boot_stage(BOOT_FIRST_READING);
+            }
+            lastCapture.valid = err == ESP_OK;
+            framesInInference--;
+        } else if (frame.failed || !lastCapture.valid) {
+            err = ESP_FAIL;
+        } else {
+            coalescedCaptures++;
+        }
+
+        // Demande rattachée à une lecture qui a échoué : une nouvelle capture plutôt qu'un 500
+        capture_job_t* job = frame.job;
+        if (job && !frame.fb && !frame.failed && err != ESP_OK && !job->retry) {
+            job->retry = true;
+            if (xQueueSend(captureQueue, &job, 0) == pdTRUE) {
+                stage_end(STAGE_INFERENCE, start);
+                continue;
+            }
+        }
+        if (job) {
+            captureRequests++;
+            if (err == ESP_OK) {
+                err = send_capture(job->req, &lastCapture.reading, lastCapture.cropped_fb, job->format, job->digits_only);
+            } else {
+                httpd_resp_send_500(job->req);
+            }
+            finish_capture_job(job);
+        } else {
+            if (err == ESP_OK) {
+                LOG_DEFERRED(LOG_READING_OK, lastCapture.reading.sequence, lastCapture.reading.value);
+            } else {
+                LOG_DEFERRED(LOG_READING_FAILED);
+            }
+            uint32_t next_ms = schedule_update(&captureSchedule, schedule_units(err, &lastCapture.reading),
+                                               sleep_clock_us());
+            esp_timer_start_once(photo_timer, (uint64_t)next_ms * 1000);
+        }
+        stage_end(STAGE_INFERENCE, start);
+    }
+}
+
+void startReadingScheduler() {
+    pipelineMutex = xSemaphoreCreateMutex();
+    captureQueue = xQueueCreate(CAPTURE_QUEUE_LENGTH, sizeof(capture_job_t*));
+    slot_pool_init(&captureJobs, CAPTURE_JOB_POOL);
+    spsc_init(&frameRing, frameSlots, FRAME_QUEUE_LENGTH, sizeof(frame_job_t));
+    xTaskCreatePinnedToCore(capture_task, "capture", 6144, NULL, 5, &captureTask, 0);
+    xTaskCreatePinnedToCore(inference_task, "inference", 8192, NULL, 5, &inferenceTask, 1);
+
+    esp_timer_create_args_t timer_args = {
+        .callback = photo_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "photo",
+    };
+    esp_timer_create(&timer_args, &photo_timer);
+    schedule_init(&captureSchedule, initialCaptureIntervalMs);
+
+    // Première lecture dès le démarrage
+    photo_timer_callback(NULL);
+}
 
 
 void startCameraServer() {
@@ -308,25 +1618,327 @@ void startCameraServer() {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 80; // You can change this port if needed
 
-    // Start the stream server
+    // Start the stream server. A stream occupies its server task for as long as the
+    // client watches, so snapshots and readings get their own server on port 81.
     if (httpd_start(&stream_httpd, &config) == ESP_OK) {
-      
+        httpd_uri_t stream_uri = {
+            .uri       = "/stream", // MJPEG stream, to align the camera during installation
+            .method    = HTTP_GET,
+            .handler   = stream_handler,
+            .user_ctx  = NULL
+        };
+        httpd_register_uri_handler(stream_httpd, &stream_uri);
+    } else {
+        Serial.println("Error starting stream server");
+    }
+
+    config.server_port += 1;
+    config.ctrl_port += 1;
 
-        // Register URI handler for the stream server
+    // Start the camera server
+    if (httpd_start(&camera_httpd, &config) == ESP_OK) {
+        // Register URI handler for the camera server
         httpd_uri_t capture_uri = {
             .uri       = "/capture", // Endpoint to capture a photo
             .method    = HTTP_GET,
             .handler   = capture_handler,
             .user_ctx  = NULL
         };
-        httpd_register_uri_handler(stream_httpd, &capture_uri);
+        httpd_register_uri_handler(camera_httpd, &capture_uri);
+
+        httpd_uri_t reading_uri = {
+            .uri       = "/reading", // Latest reading as JSON, without image
+            .method    = HTTP_GET,
+            .handler   = reading_handler,
+            .user_ctx  = NULL
+        };
+        httpd_register_uri_handler(camera_httpd, &reading_uri);
+
+        httpd_uri_t metrics_uri = {
+            .uri       = "/metrics", // Latency histograms and counters, Prometheus text format
+            .method    = HTTP_GET,
+            .handler   = metrics_handler,
+            .user_ctx  = NULL
+        };
+        httpd_register_uri_handler(camera_httpd, &metrics_uri);
+
+        httpd_uri_t trace_uri = {
+            .uri       = "/trace", // Begin/end events of the last readings, Chrome trace JSON
+            .method    = HTTP_GET,
+            .handler   = trace_handler,
+            .user_ctx  = NULL
+        };
+        httpd_register_uri_handler(camera_httpd, &trace_uri);
+
+        httpd_uri_t log_uri = {
+            .uri       = "/log", // Deferred log ring, binary, decoded by logDecode.py
+            .method    = HTTP_GET,
+            .handler   = log_handler,
+            .user_ctx  = NULL
+        };
+        httpd_register_uri_handler(camera_httpd, &log_uri);
     } else {
-        Serial.println("Error starting stream server");
+        Serial.println("Error starting camera server");
     }
 
 }
 
 
+// Paramètres de la dernière association, gardés en mémoire RTC à travers les resets et le
+// sommeil profond : canal et BSSID évitent le balayage de tous les canaux, l'adresse fixe évite
+// l'échange DHCP. La box garde normalement le même bail pour la même adresse MAC.
+#define WIFI_CACHE_MAGIC 0x57494649 // "WIFI"
+
+typedef struct {
+    uint32_t magic;
+    int32_t channel;
+    uint8_t bssid[6];
+    uint32_t ip, gateway, subnet, dns;
+    uint32_t check;
+} wifi_cache_t;
+
+RTC_NOINIT_ATTR wifi_cache_t wifiCache; // non initialisée au démarrage à froid : magic et check
+
+uint32_t wifi_cache_check(const wifi_cache_t* c) {
+    const uint8_t* p = (const uint8_t*)c;
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < offsetof(wifi_cache_t, check); i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+bool wifi_cache_valid() {
+    return wifiCache.magic == WIFI_CACHE_MAGIC && wifiCache.check == wifi_cache_check(&wifiCache);
+}
+
+void save_wifi_cache() {
+    wifi_cache_t c;
+    memset(&c, 0, sizeof(c));
+    c.magic = WIFI_CACHE_MAGIC;
+    c.channel = WiFi.channel();
+    memcpy(c.bssid, WiFi.BSSID(), sizeof(c.bssid));
+    c.ip = (uint32_t)WiFi.localIP();
+    c.gateway = (uint32_t)WiFi.gatewayIP();
+    c.subnet = (uint32_t)WiFi.subnetMask();
+    c.dns = (uint32_t)WiFi.dnsIP(0);
+    c.check = wifi_cache_check(&c);
+    wifiCache = c;
+}
+
+bool wifiStopping = false; // coupure volontaire avant le sommeil profond : ni reconnexion ni oubli du cache
+
+// Adresse utilisable : cache mis à jour, le réseau est annoncé prêt
+void wifi_connected() {
+    boot_stage(BOOT_WIFI_IP);
+    save_wifi_cache();
+    xSemaphoreGive(wifiReady);
+    IPAddress ip = WiFi.localIP();
+    LOG_DEFERRED(LOG_WIFI_READY, ip[0], ip[1], ip[2], ip[3]);
+    LOG_DEFERRED(LOG_BOOT, bootStageUs[BOOT_CAMERA], bootStageUs[BOOT_SERVER], bootStageUs[BOOT_WIFI_IP],
+                 wifiFastConnect);
+}
+
+// Fin du contrôle de la passerelle, dans la tâche ping : sans réponse, l'adresse fixe du cache
+// n'est plus bonne (bail expiré, autre sous-réseau), on se déconnecte et wifi_event repasse en DHCP
+void wifi_gateway_checked(esp_ping_handle_t ping, void* arg) {
+    uint32_t replies = 0;
+    esp_ping_get_profile(ping, ESP_PING_PROF_REPLY, &replies, sizeof(replies));
+    esp_ping_delete_session(ping);
+    if (wifiStopping) {
+        return;
+    }
+    if (replies > 0) {
+        wifi_connected();
+    } else {
+        IPAddress gateway(wifiCache.gateway);
+        LOG_DEFERRED(LOG_WIFI_GATEWAY_FAILED, gateway[0], gateway[1], gateway[2], gateway[3]);
+        WiFi.disconnect();
+    }
+}
+
+// Avec l'adresse fixe du cache, GOT_IP arrive sans échange avec le réseau : l'adresse n'est
+// annoncée qu'une fois la passerelle joignable (quelques ms sur un réseau local)
+void check_wifi_gateway() {
+    esp_ping_config_t config = ESP_PING_DEFAULT_CONFIG();
+    config.target_addr.type = IPADDR_TYPE_V4;
+    config.target_addr.u_addr.ip4.addr = wifiCache.gateway;
+    config.count = 3;
+    config.interval_ms = 100;
+    config.timeout_ms = 300;
+    esp_ping_callbacks_t callbacks = {};
+    callbacks.on_ping_end = wifi_gateway_checked;
+    esp_ping_handle_t ping;
+    if (esp_ping_new_session(&config, &callbacks, &ping) != ESP_OK || esp_ping_start(ping) != ESP_OK) {
+        wifi_connected(); // contrôle impossible : la première requête dira si l'adresse est bonne
+    }
+}
+
+// Appelé par la tâche des événements Arduino, pendant que setup() continue
+void wifi_event(WiFiEvent_t event, WiFiEventInfo_t info) {
+    if (event == ARDUINO_EVENT_WIFI_STA_CONNECTED) {
+        boot_stage(BOOT_WIFI_ASSOCIATED);
+    } else if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+        if (wifiFastConnect) {
+            check_wifi_gateway();
+        } else {
+            wifi_connected();
+        }
+    } else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED && wifiFastConnect && !wifiStopping &&
+               !bootStageUs[BOOT_WIFI_IP]) {
+        // Point d'accès changé de canal ou remplacé : on oublie le cache, balayage et DHCP
+        wifiFastConnect = false;
+        wifiCache.magic = 0;
+        LOG_DEFERRED(LOG_WIFI_FAST_FAILED, info.wifi_sta_disconnected.reason);
+        WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+        WiFi.begin(ssid, password);
+    }
+}
+
+// Lance l'association sans l'attendre : elle se fait dans la tâche Wi-Fi pendant l'initialisation
+// de la caméra et des tampons, et le serveur démarre avant qu'elle soit terminée
+void startWiFi() {
+    wifiReady = xSemaphoreCreateBinary();
+    WiFi.persistent(false); // pas d'écriture de la configuration en flash à chaque démarrage
+    WiFi.onEvent(wifi_event);
+    WiFi.mode(WIFI_STA);
+    wifiFastConnect = wifi_cache_valid();
+    if (wifiFastConnect) {
+        WiFi.config(IPAddress(wifiCache.ip), IPAddress(wifiCache.gateway), IPAddress(wifiCache.subnet),
+                    IPAddress(wifiCache.dns));
+        WiFi.begin(ssid, password, wifiCache.channel, wifiCache.bssid);
+    } else {
+        WiFi.begin(ssid, password);
+    }
+}
+
+
+// Mode sommeil profond, pour les installations sur batterie : à chaque réveil, une seule lecture
+// faite directement dans setup() (sans tâches ni serveur HTTP), envoyée par POST à publishUrl,
+// puis sommeil jusqu'au réveil suivant par le timer RTC. La dernière lecture, la disposition des
+// chiffres et le réglage du flash restent en mémoire RTC : le réveil suivant ne refait ni la
+// localisation (simple contrôle de dérive) ni la convergence de l'exposition.
+#define DEEP_SLEEP_MODE 0
+
+const char* publishUrl = "http://192.168.1.10:8080/watermeter"; // reçoit le JSON de /reading
+const int wifiWaitMs = 8000;      // au-delà, la lecture est gardée et envoyée au réveil suivant
+const int publishTimeoutMs = 3000;
+
+#define SLEEP_STATE_MAGIC 0x534C5035 // "SLP5", à changer si sleep_state_t change
+
+typedef struct {
+    uint32_t magic;
+    uint32_t wakes;
+    bool unsent;               // lecture pas encore publiée (Wi-Fi ou serveur absent)
+    meter_reading_t reading;   // après le sommeil, seul clock_us donne son âge (esp_timer repart de 0)
+    digit_layout_t layout;
+    int duty;
+    capture_schedule_t schedule; // la durée du sommeil suit aussi le débit
+    meter_state_t meter;         // index de référence : seules les unités sont relues au réveil
+} sleep_state_t;
+
+RTC_DATA_ATTR sleep_state_t sleepState; // remis à zéro au démarrage à froid, gardé pendant le sommeil
+
+void restore_sleep_state() {
+    if (sleepState.magic != SLEEP_STATE_MAGIC) {
+        memset(&sleepState, 0, sizeof(sleepState));
+        sleepState.magic = SLEEP_STATE_MAGIC;
+        schedule_init(&captureSchedule, initialCaptureIntervalMs);
+        return;
+    }
+    captureSchedule = sleepState.schedule;
+    meterState = sleepState.meter;
+    latestReading = sleepState.reading; // la numérotation des lectures continue
+    if (sleepState.layout.valid) {
+        digitLayout = sleepState.layout;
+    }
+    exposure.duty = clamp_duty(&exposure, sleepState.duty);
+}
+
+void save_sleep_state() {
+    get_latest_reading(&sleepState.reading);
+    sleepState.layout = digitLayout;
+    sleepState.duty = exposure.duty;
+    sleepState.schedule = captureSchedule;
+    sleepState.meter = meterState;
+    sleepState.wakes++;
+}
+
+bool publish_to_server(const meter_reading_t* reading) {
+    if (xSemaphoreTake(wifiReady, pdMS_TO_TICKS(wifiWaitMs)) != pdTRUE) {
+        return false;
+    }
+    char json[512];
+    format_reading_json(json, sizeof(json), reading);
+
+    HTTPClient http;
+    http.setConnectTimeout(publishTimeoutMs);
+    http.setTimeout(publishTimeoutMs);
+    if (!http.begin(publishUrl)) {
+        return false;
+    }
+    http.addHeader("Content-Type", "application/json");
+    int status = http.POST(json);
+    http.end();
+    LOG_DEFERRED(LOG_PUBLISH, status, reading->sequence);
+    if (status < 0 && wifiFastConnect) {
+        wifiCache.magic = 0; // serveur injoignable avec l'adresse du cache : DHCP au prochain réveil
+    }
+    return status >= 200 && status < 300;
+}
+
+void sleepUntilNextReading(uint32_t interval_ms) {
+    // Caméra éteinte pendant le sommeil : PWDN maintenu à l'état haut
+    esp_camera_deinit();
+    if (PWDN_GPIO_NUM >= 0) {
+        pinMode(PWDN_GPIO_NUM, OUTPUT);
+        digitalWrite(PWDN_GPIO_NUM, HIGH);
+        gpio_hold_en((gpio_num_t)PWDN_GPIO_NUM);
+    }
+    // Flash éteint : sans maintien, GPIO4 flotte pendant le sommeil et la LED peut s'allumer
+    ledcDetach(LED_GPIO_NUM);
+    pinMode(LED_GPIO_NUM, OUTPUT);
+    digitalWrite(LED_GPIO_NUM, LOW);
+    gpio_hold_en((gpio_num_t)LED_GPIO_NUM);
+    gpio_deep_sleep_hold_en();
+    wifiStopping = true;
+    WiFi.disconnect(true);
+
+    vTaskDelay(pdMS_TO_TICKS(2 * LOG_DRAIN_INTERVAL_MS)); // laisse logTask vider le journal
+    Serial.flush();
+    esp_sleep_enable_timer_wakeup((uint64_t)interval_ms * 1000);
+    esp_deep_sleep_start();
+}
+
+// Ne revient pas : lecture, publication, puis sommeil profond
+void runSleepCycle() {
+    restore_sleep_state();
+
+    frame_job_t frame;
+    memset(&frame, 0, sizeof(frame));
+    meter_reading_t reading;
+    camera_fb_t* cropped_fb = NULL;
+    esp_err_t err = capture_reading_frame(&frame);
+    if (err == ESP_OK) {
+        err = infer_reading(&frame, &reading, &cropped_fb);
+    }
+    if (err == ESP_OK) {
+        boot_stage(BOOT_FIRST_READING);
+        sleepState.unsent = true;
+    }
+    uint32_t next_ms = schedule_update(&captureSchedule, schedule_units(err, &reading), sleep_clock_us());
+
+    // Une lecture non envoyée au réveil précédent part aussi, à défaut d'une nouvelle
+    if (sleepState.unsent) {
+        get_latest_reading(&reading);
+        sleepState.unsent = !publish_to_server(&reading);
+    }
+    save_sleep_state();
+    LOG_DEFERRED(LOG_SLEEP, sleepState.wakes, bootStageUs[BOOT_FIRST_READING], (int32_t)(esp_timer_get_time() / 1000));
+    sleepUntilNextReading(next_ms);
+}
+
+
 void setup() {
     // Disable brownout detector
     WRITE_PERI_REG(RTC_CNTL_BROWN_OUT_REG, 0);
@@ -334,10 +1946,17 @@ void setup() {
     // Initialize serial communication
     Serial.begin(115200);
     Serial.setDebugOutput(false);
+#if DEEP_SLEEP_MODE
+    gpio_hold_dis((gpio_num_t)LED_GPIO_NUM); // maintenu éteint pendant le sommeil, voir sleepUntilNextReading()
+#endif
     pinMode(LED_GPIO_NUM, OUTPUT);
     setupFlashPWM(); // Initialiser le flash avec PWM
     setFlashIntensity(defaultFlashIntensity); 
-    
+
+    setupArenas();
+    setupTracer();
+    setupLog();
+    startWiFi();
     
     // Camera configuration
     camera_config_t config;
@@ -367,79 +1986,47 @@ void setup() {
         config.frame_size = FRAMESIZE_VGA; //UXGA;
         config.jpeg_quality = 10;
         config.fb_count = 2;
+        config.grab_mode = CAMERA_GRAB_LATEST; // le driver garde la dernière image au lieu de la plus ancienne
     } else {
         config.frame_size = FRAMESIZE_VGA;
         config.jpeg_quality = 12;
         config.fb_count = 1;
     }
     
+#if DEEP_SLEEP_MODE
+    if (PWDN_GPIO_NUM >= 0) {
+        gpio_hold_dis((gpio_num_t)PWDN_GPIO_NUM); // maintenu pendant le sommeil, voir runSleepCycle()
+    }
+#endif
+
     // Initialize the camera
     esp_err_t err = esp_camera_init(&config);
     if (err != ESP_OK) {
         Serial.printf("Camera init failed with error 0x%x", err);
+#if DEEP_SLEEP_MODE
+        sleepUntilNextReading(initialCaptureIntervalMs); // nouvel essai au prochain réveil plutôt que rester éveillé
+#endif
         return;
     }
+    boot_stage(BOOT_CAMERA);
     
-    // Wi-Fi connection
-    WiFi.begin(ssid, password);
-    while (WiFi.status() != WL_CONNECTED) {
-        delay(50);
-        Serial.print(".");
-    }
-    Serial.println("");
-    Serial.println("WiFi connected");
-    
-    // Print the IP address of the ESP32-CAM
-    Serial.print("Camera Stream Ready! Go to: http://");
-    Serial.print(WiFi.localIP());
-    
+    setupCropBuffer();
+    setupDigitLayout();
+    boot_stage(BOOT_BUFFERS);
+
+#if DEEP_SLEEP_MODE
+    runSleepCycle();
+#endif
+
     // Start streaming web server
+    startReadingScheduler();
     startCameraServer();
-    lastCaptureTime = millis();
+    boot_stage(BOOT_SERVER); // l'adresse IP est affichée par wifi_event dès l'association
 
 }
 
 
-const unsigned long captureInterval = 100000;
-
-
-#include <HTTPClient.h>
 void loop() {
-    // Attendre jusqu'à ce qu'il soit temps de capturer une nouvelle image
-    unsigned long currentTime = millis();
-    if (currentTime - lastCaptureTime < captureInterval) {
-        delay(10); // Attente courte avant de vérifier à nouveau
-        return;
-    }
-    // Définir l'URL de l'endpoint de capture d'image
-    String captureUrl = "http://";
-    captureUrl += WiFi.localIP().toString(); // Adresse IP locale de l'ESP32
-    captureUrl += "/capture"; // Endpoint de capture d'image
-
-    // Créer un objet HTTPClient
-    HTTPClient http;
-
-    // Commencer une nouvelle requête HTTP
-    http.begin(captureUrl);
-
-    // Envoyer une requête GET à l'endpoint de capture d'image
-    int httpCode = http.GET();
-
-    // Vérifier le code de réponse HTTP
-    if(httpCode == HTTP_CODE_OK) {
-        Serial.println("Capture d'image réussie");
-    } else {
-        Serial.print("Échec de la capture d'image, code HTTP: ");
-        Serial.println(httpCode);
-    }
-
-    // Libérer les ressources de l'objet HTTPClient
-    http.end();
-
-
-    // Mettre à jour le temps de la dernière capture
-    lastCaptureTime = currentTime;
-
-    // Attendre un certain temps avant de capturer une autre image
-    delay(10); // 10 secondes
-}
\ No newline at end of file
+    // Les lectures sont faites par capture_task et inference_task, alimentées par photo_timer
+    vTaskDelete(NULL);
+}
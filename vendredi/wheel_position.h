@@ -0,0 +1,140 @@
+// Position fractionnaire de la roue des unités, souvent prise en plein passage d'un chiffre au
+// suivant (bas du chiffre n en haut de la vignette, haut de n+1 en bas, comme les images
+// « demi-chiffre » de splitDigit.py). Deux estimations indépendantes :
+//  - les scores : si les deux meilleures classes sont consécutives (n et n+1), la part de n+1
+//    dans leur somme donne l'avancement ;
+//  - le profil vertical : la roue remonte, l'espace vide entre deux chiffres (en bordure au repos)
+//    remonte dans la vignette ; la ligne centrale de la plus longue suite circulaire de lignes
+//    vides donne le décalage, en supposant qu'un chiffre occupe une hauteur de vignette.
+// Leur écart donne la confiance de l'estimation ; au-delà d'un demi-chiffre d'écart, elles ne sont
+// pas moyennées et la confiance est nulle.
+// Aucune dépendance Arduino : ce fichier compile aussi sur PC.
+
+#ifndef __WHEEL_POSITION_H__
+#define __WHEEL_POSITION_H__
+
+#include <stdint.h>
+
+#define WHEEL_MAX_ROWS      32
+#define WHEEL_EMPTY_INK     1   // pixels d'encre tolérés dans une ligne « vide »
+#define WHEEL_SECOND_RATIO  4   // second score >= meilleur / 4 : deux chiffres visibles
+
+typedef struct {
+  bool rolling;          // entre deux chiffres
+  int16_t position;      // position de la roue en millièmes d'unité, 0..9999 sur un tour (3285 : 3,285)
+  uint8_t confidence;    // 0..100
+  int8_t shift_rows;     // décalage mesuré sur le profil, -1 sans ligne vide
+} wheel_position_t;
+
+// Lignes d'encre d'une vignette binarisée (bits de poids fort d'abord, ligne après ligne).
+// L'encre est la couleur minoritaire, quel que soit le sens du contraste.
+static void wheel_row_profile(const uint8_t* packed, int width, int height, uint8_t* profile) {
+  int ones = 0;
+  for (int y = 0; y < height; y++) {
+    profile[y] = 0;
+    for (int x = 0; x < width; x++) {
+      int i = y * width + x;
+      if (packed[i >> 3] & (0x80 >> (i & 7))) profile[y]++;
+    }
+    ones += profile[y];
+  }
+  if (ones * 2 > width * height) {
+    for (int y = 0; y < height; y++) profile[y] = width - profile[y];
+  }
+}
+
+// Décalage vers le haut du contenu, en lignes (0 au repos), -1 sans ligne vide
+static int wheel_profile_shift(const uint8_t* profile, int height) {
+  int best_start = -1, best_len = 0;
+  for (int start = 0; start < height; start++) {
+    // Début de suite seulement : la ligne précédente (circulairement) n'est pas vide
+    if (profile[start] > WHEEL_EMPTY_INK || profile[(start + height - 1) % height] <= WHEEL_EMPTY_INK) continue;
+    int len = 0;
+    while (len < height && profile[(start + len) % height] <= WHEEL_EMPTY_INK) len++;
+    if (len > best_len) {
+      best_len = len;
+      best_start = start;
+    }
+  }
+  if (best_start < 0) return -1; // aucune ligne vide, ou rien que des lignes vides
+  int center = (2 * best_start + best_len) / 2; // centre de l'espace, circulaire
+  return (height - center % height) % height;
+}
+
+// Écart circulaire b - a entre deux positions en millièmes d'unité, ramené dans [-5000, 5000[
+static int wheel_difference(int a, int b) {
+  int d = ((b - a) % 10000 + 10000) % 10000;
+  return d >= 5000 ? d - 10000 : d;
+}
+
+static void estimate_wheel_position(const int16_t* scores, const uint8_t* packed, int width, int height,
+                                    wheel_position_t* out) {
+  // Deux meilleures classes
+  int a = 0, b = -1;
+  for (int c = 1; c < 10; c++) {
+    if (scores[c] > scores[a]) {
+      b = a;
+      a = c;
+    } else if (b < 0 || scores[c] > scores[b]) {
+      b = c;
+    }
+  }
+  int sa = scores[a] > 0 ? scores[a] : 0;
+  int sb = scores[b] > 0 ? scores[b] : 0;
+
+  // Estimation par les scores : n + part de n+1
+  int by_score = a * 1000;
+  int n = a;
+  bool score_rolling = sa > 0 && sb * WHEEL_SECOND_RATIO >= sa &&
+                       ((a + 1) % 10 == b || (b + 1) % 10 == a);
+  if (score_rolling) {
+    n = (a + 1) % 10 == b ? a : b;
+    int next = n == a ? sb : sa;
+    by_score = n * 1000 + next * 1000 / (sa + sb);
+  }
+
+  // Estimation par le profil, rattachée au chiffre du bas de la paire lue par les scores
+  uint8_t profile[WHEEL_MAX_ROWS];
+  int rows = height < WHEEL_MAX_ROWS ? height : WHEEL_MAX_ROWS;
+  wheel_row_profile(packed, width, rows, profile);
+  int shift = wheel_profile_shift(profile, rows);
+  out->shift_rows = (int8_t)shift;
+
+  int position;
+  if (shift < 0) {
+    position = by_score;
+    out->confidence = score_rolling ? 50 : 70;
+  } else {
+    int fraction = shift * 1000 / rows;
+    // Sans paire, plus de la moitié du chiffre suivant visible : le meilleur score est celui de n+1
+    if (!score_rolling && fraction > 500) n = (a + 9) % 10;
+    int by_profile = n * 1000 + fraction;
+    int d = wheel_difference(by_score, by_profile);
+    // Espace presque en bordure : roue au repos sur n ou sur n+1, le plus proche des scores
+    if ((fraction < 100 || fraction > 900) && (d > 500 || d < -500)) d += d > 0 ? -1000 : 1000;
+    int distance = d < 0 ? -d : d;
+    if (distance >= 500) {
+      position = by_score; // estimations incompatibles : pas de moyenne, wheel_offset refusera
+      out->confidence = 0;
+    } else {
+      position = by_score + d / 2;
+      out->confidence = (uint8_t)(100 - distance / 5);
+    }
+  }
+  position = (position % 10000 + 10000) % 10000;
+  int fraction = position % 1000;
+  out->position = (int16_t)position;
+  out->rolling = score_rolling || (fraction >= 100 && fraction <= 900);
+}
+
+// Part fractionnaire à ajouter à l'index décodé (unités `units`), en millièmes dans ]-1000, 1000[ ;
+// false si l'estimation n'est pas fiable, ou si la roue est trop loin du chiffre retenu par le décodeur
+static bool wheel_offset(const wheel_position_t* wheel, int units, int* offset) {
+  if (wheel->confidence == 0) return false;
+  int d = wheel_difference(units * 1000, wheel->position);
+  if (d <= -1000 || d >= 1000) return false;
+  *offset = d;
+  return true;
+}
+
+#endif // __WHEEL_POSITION_H__